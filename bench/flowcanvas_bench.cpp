@@ -0,0 +1,674 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/** FlowCanvas benchmark.
+ *
+ * Builds synthetic graphs and times common canvas operations on them,
+ * writing the results as JSON.  Run under a real or virtual X server
+ * (e.g. xvfb-run), or with --headless to time only the graph model.
+ */
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <locale>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <gtkmm.h>
+
+#include "flowcanvas/Canvas.hpp"
+#include "flowcanvas/GraphModel.hpp"
+#include "flowcanvas/Instrument.hpp"
+#include "flowcanvas/MemoryReport.hpp"
+#include "flowcanvas/Module.hpp"
+#include "flowcanvas/Port.hpp"
+
+using std::cerr;
+using std::endl;
+using std::string;
+using std::vector;
+
+using namespace FlowCanvas;
+
+namespace {
+
+
+struct ModuleDesc {
+	ModuleDesc(const string& n, unsigned ins, unsigned outs)
+		: name(n), n_inputs(ins), n_outputs(outs) {}
+
+	string   name;
+	unsigned n_inputs;
+	unsigned n_outputs;
+};
+
+
+/** A connection from output @a tail_port of @a tail to input @a head_port of @a head. */
+struct EdgeDesc {
+	EdgeDesc(unsigned t, unsigned tp, unsigned h, unsigned hp)
+		: tail(t), tail_port(tp), head(h), head_port(hp) {}
+
+	inline bool operator<(const EdgeDesc& e) const {
+		if (tail != e.tail)           return tail < e.tail;
+		if (tail_port != e.tail_port) return tail_port < e.tail_port;
+		if (head != e.head)           return head < e.head;
+		return head_port < e.head_port;
+	}
+
+	unsigned tail;
+	unsigned tail_port;
+	unsigned head;
+	unsigned head_port;
+};
+
+
+struct GraphDesc {
+	string             generator;
+	vector<ModuleDesc> modules;
+	vector<EdgeDesc>   edges;
+
+	size_t num_ports() const {
+		size_t n = 0;
+		for (vector<ModuleDesc>::const_iterator m = modules.begin(); m != modules.end(); ++m)
+			n += m->n_inputs + m->n_outputs;
+		return n;
+	}
+};
+
+
+/** Small deterministic random number generator, so runs are comparable. */
+class Random {
+public:
+	explicit Random(uint32_t seed) : _state(seed ? seed : 1) {}
+
+	uint32_t next(uint32_t range) {
+		_state = _state * 1664525u + 1013904223u;
+		return (_state >> 8) % range;
+	}
+
+	double next_double(double max) { return next(1 << 20) / double(1 << 20) * max; }
+
+private:
+	uint32_t _state;
+};
+
+
+static string
+module_name(const char* prefix, unsigned i)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%s %u", prefix, i);
+	return name;
+}
+
+
+/** Add up to @a c random connections (no duplicates) to @a g. */
+static void
+add_random_edges(GraphDesc& g, size_t c, Random& random)
+{
+	std::set<EdgeDesc> existing(g.edges.begin(), g.edges.end());
+	const unsigned n = g.modules.size();
+	for (size_t tries = 0; g.edges.size() < c && tries < c * 8; ++tries) {
+		const unsigned tail = random.next(n);
+		const unsigned head = random.next(n);
+		if (tail == head || !g.modules[tail].n_outputs || !g.modules[head].n_inputs)
+			continue;
+
+		const EdgeDesc e(tail, random.next(g.modules[tail].n_outputs),
+		                 head, random.next(g.modules[head].n_inputs));
+		if (existing.insert(e).second)
+			g.edges.push_back(e);
+	}
+}
+
+
+/** Each module feeds the next, port to port. */
+static GraphDesc
+make_chain(unsigned n, unsigned p, size_t c, Random& random)
+{
+	GraphDesc g;
+	g.generator = "chain";
+	for (unsigned i = 0; i < n; ++i)
+		g.modules.push_back(ModuleDesc(module_name("chain", i), p, p));
+
+	for (unsigned i = 0; i + 1 < n; ++i)
+		for (unsigned k = 0; k < p; ++k)
+			if (!c || g.edges.size() < c)
+				g.edges.push_back(EdgeDesc(i, k, i + 1, k));
+
+	add_random_edges(g, c, random);
+	return g;
+}
+
+
+/** One source module feeding every other module. */
+static GraphDesc
+make_fanout(unsigned n, unsigned p, size_t c, Random& random)
+{
+	GraphDesc g;
+	g.generator = "fanout";
+	g.modules.push_back(ModuleDesc("source", 0, p));
+	for (unsigned i = 1; i < n; ++i)
+		g.modules.push_back(ModuleDesc(module_name("sink", i), p, 0));
+
+	for (unsigned i = 1; i < n; ++i)
+		for (unsigned k = 0; k < p; ++k)
+			if (!c || g.edges.size() < c)
+				g.edges.push_back(EdgeDesc(0, k, i, k));
+
+	add_random_edges(g, c, random);
+	return g;
+}
+
+
+/** Random connections between modules (n * p by default). */
+static GraphDesc
+make_mesh(unsigned n, unsigned p, size_t c, Random& random)
+{
+	GraphDesc g;
+	g.generator = "mesh";
+	for (unsigned i = 0; i < n; ++i)
+		g.modules.push_back(ModuleDesc(module_name("node", i), p, p));
+
+	add_random_edges(g, c ? c : size_t(n) * p, random);
+	return g;
+}
+
+
+/** A typical audio patchbay.
+ *
+ * Hardware capture and playback modules with many ports, and clients with
+ * stereo inputs and outputs arranged in short effect chains, plus some
+ * random sends between clients.  There are @a n modules in total (at least
+ * the two hardware ones).
+ */
+static GraphDesc
+make_patchbay(unsigned n, unsigned p, size_t c, Random& random)
+{
+	GraphDesc g;
+	g.generator = "patchbay";
+
+	const unsigned hw_ports = std::max(2u, p * 4);
+	g.modules.push_back(ModuleDesc("system capture", 0, hw_ports));
+	g.modules.push_back(ModuleDesc("system playback", hw_ports, 0));
+
+	static const unsigned CHAIN_LENGTH = 4;
+	for (unsigned i = 2; i < n; ++i) {
+		g.modules.push_back(ModuleDesc(module_name("client", i), 2, 2));
+		const unsigned pos = (i - 2) % CHAIN_LENGTH;
+		const unsigned hw  = ((i - 2) / CHAIN_LENGTH * 2) % hw_ports;
+		for (unsigned k = 0; k < 2; ++k) {
+			if (pos == 0)
+				g.edges.push_back(EdgeDesc(0, (hw + k) % hw_ports, i, k));
+			else
+				g.edges.push_back(EdgeDesc(i - 1, k, i, k));
+		}
+		if (pos == CHAIN_LENGTH - 1 || i + 1 == n)
+			for (unsigned k = 0; k < 2; ++k)
+				g.edges.push_back(EdgeDesc(i, k, 1, (hw + k) % hw_ports));
+	}
+
+	add_random_edges(g, c ? c : g.edges.size() + n / 4, random);
+	return g;
+}
+
+
+class Timer {
+public:
+	Timer() { _start.assign_current_time(); }
+
+	double elapsed_ms() const {
+		Glib::TimeVal now;
+		now.assign_current_time();
+		now -= _start;
+		return now.as_double() * 1000.0;
+	}
+
+private:
+	Glib::TimeVal _start;
+};
+
+
+struct Result {
+	Result(const string& n, size_t o, double m) : name(n), ops(o), ms(m) {}
+
+	string name;
+	size_t ops;
+	double ms;
+};
+
+typedef vector<Result> Results;
+
+
+/** Process all pending events, including canvas redraws. */
+static void
+flush()
+{
+	while (Gtk::Main::events_pending())
+		Gtk::Main::iteration(false);
+}
+
+
+/** Time operations on a real Canvas. */
+static void
+bench_canvas(const GraphDesc& g, Random& random, bool arrange,
+             Results& results, MemoryReport& memory)
+{
+	Gtk::Window window;
+	window.set_default_size(800, 600);
+
+	boost::shared_ptr<Canvas> canvas(new Canvas(1600, 1200));
+	window.add(*canvas.get());
+	window.show_all();
+	flush();
+
+	vector< boost::shared_ptr<Module> > modules;
+	modules.reserve(g.modules.size());
+	vector< vector< boost::shared_ptr<Port> > > inputs(g.modules.size());
+	vector< vector< boost::shared_ptr<Port> > > outputs(g.modules.size());
+
+	Timer t;
+	for (size_t i = 0; i < g.modules.size(); ++i) {
+		const ModuleDesc& desc = g.modules[i];
+		boost::shared_ptr<Module> m = boost::allocate_shared<Module>(
+			canvas->allocator<Module>(), canvas, desc.name,
+			random.next_double(1400.0), random.next_double(1000.0));
+		for (unsigned k = 0; k < desc.n_inputs; ++k) {
+			boost::shared_ptr<Port> p = boost::allocate_shared<Port>(
+				canvas->allocator<Port>(), m, module_name("in", k), true, 0x394C6AFF);
+			m->add_port(p);
+			inputs[i].push_back(p);
+		}
+		for (unsigned k = 0; k < desc.n_outputs; ++k) {
+			boost::shared_ptr<Port> p = boost::allocate_shared<Port>(
+				canvas->allocator<Port>(), m, module_name("out", k), false, 0x6A4C39FF);
+			m->add_port(p);
+			outputs[i].push_back(p);
+		}
+		m->resize();
+		canvas->add_item(m);
+		modules.push_back(m);
+	}
+	flush();
+	results.push_back(Result("add_item", modules.size(), t.elapsed_ms()));
+
+	t = Timer();
+	for (vector<EdgeDesc>::const_iterator e = g.edges.begin(); e != g.edges.end(); ++e)
+		canvas->add_connection(outputs[e->tail][e->tail_port], inputs[e->head][e->head_port],
+		                       0x8899AAFF);
+	flush();
+	results.push_back(Result("add_connection", g.edges.size(), t.elapsed_ms()));
+
+	t = Timer();
+	for (size_t i = 0; i < modules.size(); ++i)
+		canvas->select_item(modules[i]);
+	canvas->clear_selection();
+	flush();
+	results.push_back(Result("select_item", modules.size(), t.elapsed_ms()));
+
+	double x1, y1, x2, y2;
+	canvas->get_contents_bounds(x1, y1, x2, y2);
+
+	// Rubber band selection
+	static const size_t N_RECTS = 100;
+	t = Timer();
+	for (size_t i = 0; i < N_RECTS; ++i) {
+		const double rx = x1 + random.next_double(x2 - x1);
+		const double ry = y1 + random.next_double(y2 - y1);
+		canvas->select_region(rx, ry, rx + 400.0, ry + 300.0);
+		canvas->clear_selection();
+	}
+	flush();
+	results.push_back(Result("rubber_band_select", N_RECTS, t.elapsed_ms()));
+
+	static const size_t N_POINTS = 10000;
+	t = Timer();
+	for (size_t i = 0; i < N_POINTS; ++i)
+		canvas->get_port_at(x1 + random.next_double(x2 - x1),
+		                    y1 + random.next_double(y2 - y1));
+	results.push_back(Result("get_port_at", N_POINTS, t.elapsed_ms()));
+
+	static const size_t N_ZOOMS = 20;
+	t = Timer();
+	for (size_t i = 0; i < N_ZOOMS; ++i) {
+		canvas->set_zoom(0.5 + 1.5 * i / N_ZOOMS);
+		flush();
+	}
+	canvas->set_zoom(1.0);
+	results.push_back(Result("set_zoom", N_ZOOMS, t.elapsed_ms()));
+
+	static const size_t N_RESIZES = 20;
+	t = Timer();
+	for (size_t i = 0; i < N_RESIZES; ++i) {
+		canvas->resize(canvas->width() + 50.0, canvas->height() + 50.0);
+		flush();
+	}
+	results.push_back(Result("resize", N_RESIZES, t.elapsed_ms()));
+
+	if (arrange) {
+		canvas->clear_layout_cache();
+		t = Timer();
+		canvas->arrange();
+		flush();
+		results.push_back(Result("arrange", 1, t.elapsed_ms()));
+
+		t = Timer();
+		canvas->arrange();
+		flush();
+		results.push_back(Result("arrange_cached", 1, t.elapsed_ms()));
+	}
+
+	memory = canvas->memory_report();
+
+	t = Timer();
+	for (vector<EdgeDesc>::const_iterator e = g.edges.begin(); e != g.edges.end(); ++e)
+		canvas->remove_connection(outputs[e->tail][e->tail_port], inputs[e->head][e->head_port]);
+	flush();
+	results.push_back(Result("remove_connection", g.edges.size(), t.elapsed_ms()));
+
+	inputs.clear();
+	outputs.clear();
+
+	t = Timer();
+	for (size_t i = 0; i < modules.size(); ++i)
+		canvas->remove_item(modules[i]);
+	modules.clear();
+	flush();
+	results.push_back(Result("remove_item", g.modules.size(), t.elapsed_ms()));
+
+	// Internal operation totals, if FlowCanvas was configured with --instrument
+	if (Canvas::instrumented()) {
+		for (unsigned i = 0; i < N_OPERATIONS; ++i) {
+			const OperationStats& stats = canvas->operation_stats(Operation(i));
+			results.push_back(Result(string("op_") + operation_name(Operation(i)),
+			                         stats.count, stats.total_us / 1000.0));
+		}
+	}
+
+	window.remove();
+}
+
+
+/** Time the equivalent operations on a GraphModel alone. */
+static void
+bench_model(const GraphDesc& g, Random& random, Results& results, MemoryReport& memory)
+{
+	GraphModel model;
+
+	vector<GraphModel::ItemID>          items;
+	vector< vector<GraphModel::PortID> > inputs(g.modules.size());
+	vector< vector<GraphModel::PortID> > outputs(g.modules.size());
+
+	Timer t;
+	for (size_t i = 0; i < g.modules.size(); ++i) {
+		const ModuleDesc& desc = g.modules[i];
+		const double      h    = 20.0 + 16.0 * std::max(desc.n_inputs, desc.n_outputs);
+		const GraphModel::ItemID item = model.add_item(GraphModel::MODULE, desc.name,
+			random.next_double(1400.0), random.next_double(1000.0), 100.0, h);
+		for (unsigned k = 0; k < desc.n_inputs; ++k) {
+			inputs[i].push_back(model.add_port(item, module_name("in", k), true));
+			model.set_port_geometry(inputs[i].back(), 0.0, 20.0 + 16.0 * k, 40.0, 15.0);
+		}
+		for (unsigned k = 0; k < desc.n_outputs; ++k) {
+			outputs[i].push_back(model.add_port(item, module_name("out", k), false));
+			model.set_port_geometry(outputs[i].back(), 60.0, 20.0 + 16.0 * k, 40.0, 15.0);
+		}
+		items.push_back(item);
+	}
+	results.push_back(Result("add_item", items.size(), t.elapsed_ms()));
+
+	vector<GraphModel::EdgeID> edges;
+	t = Timer();
+	for (vector<EdgeDesc>::const_iterator e = g.edges.begin(); e != g.edges.end(); ++e)
+		edges.push_back(model.add_edge(items[e->tail], outputs[e->tail][e->tail_port],
+		                               items[e->head], inputs[e->head][e->head_port]));
+	results.push_back(Result("add_connection", edges.size(), t.elapsed_ms()));
+
+	t = Timer();
+	vector<GraphModel::EdgeID> selected;
+	for (size_t i = 0; i < items.size(); ++i)
+		model.select_item(items[i], selected);
+	model.clear_selection();
+	results.push_back(Result("select_item", items.size(), t.elapsed_ms()));
+
+	double x1, y1, x2, y2;
+	model.get_bounds(x1, y1, x2, y2);
+
+	static const size_t N_RECTS = 100;
+	t = Timer();
+	for (size_t i = 0; i < N_RECTS; ++i) {
+		const double rx = x1 + random.next_double(x2 - x1);
+		const double ry = y1 + random.next_double(y2 - y1);
+		vector<GraphModel::ItemID> within;
+		model.items_within(rx, ry, rx + 400.0, ry + 300.0, within);
+		for (size_t j = 0; j < within.size(); ++j)
+			model.select_item(within[j], selected);
+		model.clear_selection();
+	}
+	results.push_back(Result("rubber_band_select", N_RECTS, t.elapsed_ms()));
+
+	static const size_t N_POINTS = 10000;
+	t = Timer();
+	for (size_t i = 0; i < N_POINTS; ++i)
+		model.port_at(x1 + random.next_double(x2 - x1), y1 + random.next_double(y2 - y1));
+	results.push_back(Result("get_port_at", N_POINTS, t.elapsed_ms()));
+
+	t = Timer();
+	vector<GraphModel::ItemID> order;
+	model.layout_order(order);
+	model.layout_key(order, 0);
+	results.push_back(Result("layout_key", 1, t.elapsed_ms()));
+
+	memory[MEM_MODEL].count        = 1;
+	memory[MEM_MODEL].object_bytes = model.memory_bytes();
+
+	t = Timer();
+	for (size_t i = 0; i < edges.size(); ++i)
+		model.remove_edge(edges[i]);
+	results.push_back(Result("remove_connection", edges.size(), t.elapsed_ms()));
+
+	t = Timer();
+	for (size_t i = 0; i < items.size(); ++i)
+		model.remove_item(items[i]);
+	results.push_back(Result("remove_item", items.size(), t.elapsed_ms()));
+}
+
+
+static string
+json_string(const string& s)
+{
+	string ret = "\"";
+	for (string::const_iterator c = s.begin(); c != s.end(); ++c) {
+		if (*c == '"' || *c == '\\')
+			ret += '\\';
+		ret += *c;
+	}
+	return ret + "\"";
+}
+
+
+static void
+write_run(std::ostream&      os,
+          const GraphDesc&    g,
+          bool                headless,
+          const Results&      results,
+          const MemoryReport& memory)
+{
+	os << "  {\n"
+	   << "    \"generator\": " << json_string(g.generator) << ",\n"
+	   << "    \"mode\": " << json_string(headless ? "headless" : "canvas") << ",\n"
+	   << "    \"modules\": " << g.modules.size() << ",\n"
+	   << "    \"ports\": " << g.num_ports() << ",\n"
+	   << "    \"connections\": " << g.edges.size() << ",\n"
+	   << "    \"results\": {\n";
+
+	for (Results::const_iterator r = results.begin(); r != results.end(); ++r) {
+		os << "      " << json_string(r->name) << ": { "
+		   << "\"ops\": " << r->ops << ", "
+		   << "\"total_ms\": " << r->ms << ", "
+		   << "\"per_op_us\": " << (r->ops ? r->ms * 1000.0 / r->ops : 0.0) << " }"
+		   << ((r + 1 != results.end()) ? ",\n" : "\n");
+	}
+
+	os << "    },\n"
+	   << "    \"memory\": {\n";
+	for (unsigned i = 0; i < N_MEMORY_CATEGORIES; ++i) {
+		const MemoryUsage& u = memory[MemoryCategory(i)];
+		os << "      " << json_string(memory_category_name(MemoryCategory(i))) << ": { "
+		   << "\"count\": " << u.count << ", "
+		   << "\"object_bytes\": " << u.object_bytes << ", "
+		   << "\"gobject_bytes\": " << u.gobject_bytes << ", "
+		   << "\"text_bytes\": " << u.text_bytes << " },\n";
+	}
+	os << "      \"pool_bytes\": " << memory.pool_bytes << ",\n"
+	   << "      \"total_bytes\": " << memory.total().total_bytes() << "\n"
+	   << "    }\n  }";
+}
+
+
+static void
+print_usage(const char* name)
+{
+	cerr << "Usage: " << name << " [OPTION]..." << endl
+	     << "Time FlowCanvas operations on synthetic graphs, writing JSON results." << endl << endl
+	     << "  -g NAME     Generator: chain, fanout, mesh, patchbay or all [all]" << endl
+	     << "  -n N        Number of modules [100]" << endl
+	     << "  -p P        Input and output ports per module [4]" << endl
+	     << "  -c C        Number of connections [generator specific]" << endl
+	     << "  -s SEED     Random seed [1]" << endl
+	     << "  -o FILE     Write results to FILE [stdout]" << endl
+	     << "  --no-arrange  Do not time arrange()" << endl
+	     << "  --headless  Time the graph model only (no display required)" << endl;
+}
+
+
+} // namespace
+
+
+int
+main(int argc, char** argv)
+{
+	string   generator = "all";
+	unsigned n         = 100;
+	unsigned p         = 4;
+	size_t   c         = 0;
+	uint32_t seed      = 1;
+	string   output;
+	bool     headless  = false;
+	bool     arrange   = true;
+
+	for (int i = 1; i < argc; ++i) {
+		const string arg = argv[i];
+		const bool   has_value = (i + 1 < argc);
+		if (arg == "-g" && has_value) {
+			generator = argv[++i];
+		} else if (arg == "-n" && has_value) {
+			n = strtoul(argv[++i], NULL, 10);
+		} else if (arg == "-p" && has_value) {
+			p = strtoul(argv[++i], NULL, 10);
+		} else if (arg == "-c" && has_value) {
+			c = strtoul(argv[++i], NULL, 10);
+		} else if (arg == "-s" && has_value) {
+			seed = strtoul(argv[++i], NULL, 10);
+		} else if (arg == "-o" && has_value) {
+			output = argv[++i];
+		} else if (arg == "--headless") {
+			headless = true;
+		} else if (arg == "--no-arrange") {
+			arrange = false;
+		} else {
+			print_usage(argv[0]);
+			return (arg == "-h" || arg == "--help") ? 0 : 1;
+		}
+	}
+
+	if (n < 2 || p < 1) {
+		cerr << "At least 2 modules with 1 port are required" << endl;
+		return 1;
+	}
+
+	typedef GraphDesc (*Generator)(unsigned, unsigned, size_t, Random&);
+	vector<Generator> generators;
+	if (generator == "chain" || generator == "all")
+		generators.push_back(make_chain);
+	if (generator == "fanout" || generator == "all")
+		generators.push_back(make_fanout);
+	if (generator == "mesh" || generator == "all")
+		generators.push_back(make_mesh);
+	if (generator == "patchbay" || generator == "all")
+		generators.push_back(make_patchbay);
+
+	if (generators.empty()) {
+		cerr << "Unknown generator '" << generator << "'" << endl;
+		return 1;
+	}
+
+	Gtk::Main* kit = NULL;
+	if (!headless) {
+		kit = new Gtk::Main(argc, argv);
+		Gnome::Canvas::init();
+	}
+
+	std::ostringstream os;
+	os.imbue(std::locale::classic());
+	os << "[\n";
+	for (size_t i = 0; i < generators.size(); ++i) {
+		Random    random(seed);
+		GraphDesc g = generators[i](n, p, c, random);
+
+		cerr << g.generator << ": " << g.modules.size() << " modules, "
+		     << g.num_ports() << " ports, " << g.edges.size() << " connections" << endl;
+
+		Results      results;
+		MemoryReport memory;
+		if (headless)
+			bench_model(g, random, results, memory);
+		else
+			bench_canvas(g, random, arrange, results, memory);
+
+		write_run(os, g, headless, results, memory);
+		os << ((i + 1 < generators.size()) ? ",\n" : "\n");
+	}
+	os << "]\n";
+
+	if (output.empty()) {
+		std::cout << os.str();
+	} else {
+		std::ofstream out(output.c_str());
+		out << os.str();
+		if (!out.good()) {
+			cerr << "Failed to write " << output << endl;
+			delete kit;
+			return 1;
+		}
+	}
+
+	delete kit;
+	return 0;
+}
@@ -19,7 +19,11 @@
 #define FLOWCANVAS_CANVAS_HPP
 
 #include <list>
+#include <map>
+#include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/utility.hpp>
@@ -27,8 +31,13 @@
 #include <libgnomecanvasmm.h>
 
 #include "flowcanvas/Connection.hpp"
+#include "flowcanvas/GraphDescription.hpp"
+#include "flowcanvas/GraphModel.hpp"
+#include "flowcanvas/Instrument.hpp"
+#include "flowcanvas/MemoryReport.hpp"
 #include "flowcanvas/Item.hpp"
 #include "flowcanvas/Module.hpp"
+#include "flowcanvas/PoolAllocator.hpp"
 
 
 /** FlowCanvas namespace, everything is defined under this.
@@ -40,6 +49,14 @@ namespace FlowCanvas {
 class Port;
 class Module;
 class GVNodes;
+class CommandQueue;
+class ControlStream;
+struct GraphCommand;
+class Hud;
+class LayoutCache;
+class SnapIndex;
+class TraceBuffer;
+struct SyncIndex;
 
 
 /** \defgroup FlowCanvas FlowCanvas
@@ -89,11 +106,46 @@ public:
 	void unselect_item(boost::shared_ptr<Item> item);
 	void unselect_connection(Connection* c);
 
+	/** Toggle the selection of items within a rectangle (as a rubber band does). */
+	void select_region(double x1, double y1, double x2, double y2);
+
+	/** Return the port at world position (@a x, @a y), if any. */
+	boost::shared_ptr<Port> get_port_at(double x, double y);
+
 	ItemList&       items()                { return _items; }
 	ItemList&       selected_items()       { return _selected_items; }
 	ConnectionList& connections()          { return _connections; }
 	ConnectionList& selected_connections() { return _selected_connections; }
 
+	/** Headless model of the graph on this canvas (kept up to date by items). */
+	const GraphModel& model() const { return _model; }
+
+	/** Return true iff FlowCanvas was configured with --instrument. */
+	static bool instrumented();
+
+	const OperationStats& operation_stats(Operation op) const { return _stats[op]; }
+	void                  reset_operation_stats();
+
+	/** Return estimated memory use of this canvas and everything on it. */
+	MemoryReport memory_report() const;
+
+	/** Show a display of frame times and item counts over the canvas. */
+	void set_show_hud(bool show);
+	bool show_hud() const { return _hud != NULL; }
+
+	/** Return an allocator for objects on this canvas.
+	 *
+	 * Objects created with boost::allocate_shared and this allocator are
+	 * packed together with others of the same size, and released in bulk
+	 * after destroy() once the last reference to them is gone.
+	 */
+	template<typename T>
+	PoolAllocator<T> allocator() const { return PoolAllocator<T>(_pools); }
+
+	void set_tracing(bool enable);
+	bool tracing() const { return _tracing; }
+	bool dump_trace(const std::string& filename) const;
+
 	void lock(bool l);
 	bool locked() const { return _locked; }
 
@@ -104,12 +156,27 @@ public:
 	void render_to_dot(const std::string& filename);
 	virtual void arrange(bool use_length_hints=false, bool center=true);
 
+	void set_layout_cache_file(const std::string& filename);
+	void clear_layout_cache();
+
 	void move_contents_to(double x, double y);
 
+	bool get_contents_bounds(double& x1, double& y1, double& x2, double& y2);
+
+	typedef std::map< boost::shared_ptr<Item>, Gnome::Art::Point > ItemPositions;
+
+	void apply_positions(const ItemPositions& positions);
+	void animate_positions(const ItemPositions& positions);
+
+	/** Set the duration of animated layout transitions (0 to disable). */
+	void   set_animation_duration(double seconds) { _animation_duration = seconds; }
+	double animation_duration() const             { return _animation_duration; }
+
 	double width() const  { return _width; }
 	double height() const { return _height; }
 
 	void resize(double width, double height);
+	void expand(double width, double height);
 	void resize_all_items();
 
 	void scroll_to_center();
@@ -126,6 +193,23 @@ public:
 	 * Set an object's property_dash() to this for the "rubber band" effect */
 	ArtVpathDash* select_dash() { return _select_dash; }
 
+	/** Fixed stacking layers, bottom to top. */
+	enum Layer {
+		LAYER_BACKGROUND,  ///< Selection rectangle
+		LAYER_CONNECTIONS, ///< Connections
+		LAYER_ITEMS,       ///< Modules and other items
+		LAYER_HIGHLIGHTED, ///< Highlighted connections
+		LAYER_OVERLAY,     ///< Performance display
+		N_LAYERS
+	};
+
+	/** Group for objects in @a l, the parent of all items of that kind.
+	 *
+	 * Objects are never restacked across the whole canvas, a connection
+	 * is moved between the connection layers when highlighted instead.
+	 */
+	Gnome::Canvas::Group* layer(Layer l) const { return _layers[l]; }
+
 	/** Make a connection.  Should be overridden by an implementation to do something. */
 	virtual void connect(boost::shared_ptr<Connectable> /*tail*/,
 	                     boost::shared_ptr<Connectable> /*head*/) {}
@@ -134,9 +218,89 @@ public:
 	virtual void disconnect(boost::shared_ptr<Connectable> /*tail*/,
 	                        boost::shared_ptr<Connectable> /*head*/) {}
 
+	typedef std::pair< boost::shared_ptr<Connectable>, boost::shared_ptr<Connectable> > ConnectablePair;
+	typedef std::vector<ConnectablePair>                                                ConnectablePairs;
+
+	/** Make several connections (tail, head) at once.
+	 *
+	 * Called instead of connect() when a single user action makes more than
+	 * one connection.  The default implementation calls connect() for each.
+	 */
+	virtual void connect_many(const ConnectablePairs& pairs);
+
+	/** Remove several connections (tail, head) at once.
+	 *
+	 * Called instead of disconnect() when a single user action removes more
+	 * than one connection.  The default implementation calls disconnect() for
+	 * each.
+	 */
+	virtual void disconnect_many(const ConnectablePairs& pairs);
+
+	void sync(const GraphDescription& graph);
+
+	/** Allow posting up to 2^@a order commands from other threads at a time.
+	 *
+	 * Must be called from the GUI thread before any thread calls a post_
+	 * method (which fail until then).  Posted commands act on objects by the
+	 * IDs used by sync(), and are applied from the GUI thread when idle.
+	 * The queue is checked once per frame while commands arrive, and every
+	 * 100 ms once nothing has been posted for a few frames.
+	 */
+	void enable_command_queue(unsigned order=10);
+
+	/** @name Thread-safe graph changes
+	 * These may be called from any thread (including realtime threads:
+	 * they never block or allocate).  They return false if the command
+	 * queue is not enabled or full, or if a string is too long.
+	 */
+	//@{
+	bool post_add_module(const char* id, const char* name, double x=0, double y=0);
+	bool post_remove_module(const char* id);
+	bool post_add_port(const char* module_id, const char* port_id, const char* name,
+	                   bool is_input, uint32_t color);
+	bool post_remove_port(const char* module_id, const char* port_id);
+	bool post_connect(const char* tail_module_id, const char* tail_port_id,
+	                  const char* head_module_id, const char* head_port_id,
+	                  uint32_t color);
+	bool post_disconnect(const char* tail_module_id, const char* tail_port_id,
+	                     const char* head_module_id, const char* head_port_id);
+	bool post_rename_module(const char* id, const char* name);
+	bool post_rename_port(const char* module_id, const char* port_id, const char* name);
+	bool post_set_control(const char* module_id, const char* port_id, float value);
+	//@}
+
+	/** Allow streaming control values to up to @a max_ports ports at a time.
+	 *
+	 * Must be called from the GUI thread before add_control_stream().
+	 */
+	void enable_control_stream(size_t max_ports=1024);
+
+	/** Start streaming control values to @a port (GUI thread).
+	 *
+	 * Returns a handle for stream_control(), or -1 if streaming is not
+	 * enabled or all slots are taken.  Slots of destroyed ports are not
+	 * freed until remove_control_stream() is called.
+	 */
+	int  add_control_stream(boost::shared_ptr<Port> port);
+	void remove_control_stream(int handle);
+
+	/** Set the control value of the port with @a handle (any thread).
+	 *
+	 * This never blocks or allocates and may be called at any rate: the
+	 * latest value for each port is applied once per frame, gauges that are
+	 * off screen are not redrawn until they are visible, and changes smaller
+	 * than a pixel are not redrawn at all.  Port::signal_control_changed is
+	 * not emitted.  Frames stop shortly after the values stop changing, and
+	 * the GUI thread then checks for new values every 100 ms.
+	 */
+	void stream_control(int handle, float value);
+
 	static sigc::signal<void, Gnome::Canvas::Item*> signal_item_entered;
 	static sigc::signal<void, Gnome::Canvas::Item*> signal_item_left;
 
+	/** Emitted once for every apply_positions() with all moved items. */
+	sigc::signal<void, const ItemList&> signal_items_moved;
+
 protected:
 	ItemList                                   _items;  ///< All items on this canvas
 	ConnectionList                             _connections;  ///< All connections on this canvas
@@ -145,14 +309,50 @@ protected:
 
 	virtual bool canvas_event(GdkEvent* event);
 	virtual bool frame_event(GdkEvent* ev);
+	virtual bool on_expose_event(GdkEventExpose* event);
+	virtual bool on_event(GdkEvent* event);
+
+	/** Create a module for sync().  The default creates a plain Module. */
+	virtual boost::shared_ptr<Module> create_module(const ModuleDescription& desc);
+
+	/** Create a port on @a module for sync().  The default creates a plain Port. */
+	virtual boost::shared_ptr<Port> create_port(boost::shared_ptr<Module> module,
+	                                            const PortDescription&    desc);
+
+	/** Return true if a connection dragged from @a port may snap to @a target.
+	 *
+	 * Only called for ports of the opposite direction, once when the drag
+	 * starts.  The default allows all of them.
+	 */
+	virtual bool can_snap_to(boost::shared_ptr<Port> /*port*/,
+	                         boost::shared_ptr<Port> /*target*/) { return true; }
 
 private:
+	friend class Item;
 	friend class Module;
+	friend class ScopedOperation;
 	bool port_event(GdkEvent* event, boost::weak_ptr<Port> port);
 
-	GVNodes layout_dot(bool use_length_hints, const std::string& filename);
+	typedef std::vector< boost::shared_ptr<Item> > LayoutNodes;
+	typedef std::vector<GraphModel::ItemID>        LayoutIDs;
+
+	void    layout_nodes(bool use_length_hints, LayoutIDs& ids, LayoutNodes& nodes);
+	GVNodes layout_dot(const LayoutNodes& nodes,
+	                   bool               use_length_hints,
+	                   const std::string& filename);
+
+	void add_port_to_model(boost::shared_ptr<Port> port);
+	void remove_port_from_model(Port& port);
+	void add_connection_to_model(boost::shared_ptr<Connection> c);
+	bool model_endpoint(boost::shared_ptr<const Connectable> c,
+	                    GraphModel::ItemID&                  item,
+	                    GraphModel::PortID&                  port) const;
 
 	void remove_connection(boost::shared_ptr<Connection> c);
+	void remove_connections(const ConnectionList& connections);
+	void unlink_connection(boost::shared_ptr<Connection> c);
+	void remove_items(const ItemList& items);
+	void unlink_item(boost::shared_ptr<Item> item);
 	bool are_connected(boost::shared_ptr<const Connectable> tail,
 	                   boost::shared_ptr<const Connectable> head);
 
@@ -162,29 +362,107 @@ private:
 	void selection_joined_with(boost::shared_ptr<Port> port);
 	void join_selection();
 
-	boost::shared_ptr<Port> get_port_at(double x, double y);
-
 	bool scroll_drag_handler(GdkEvent* event);
 	bool select_drag_handler(GdkEvent* event);
 	bool connection_drag_handler(GdkEvent* event);
+	void find_snap_targets(boost::shared_ptr<Port> port, SnapIndex& targets);
+
+	bool defer_motion(GdkEvent* event);
+	void defer_drag(boost::shared_ptr<Item> item, double dx, double dy);
+	void flush_motion();
+
+	/** Pointer motion of a drag, handled once per frame. */
+	struct PendingMotion {
+		PendingMotion()
+			: x(0), y(0), x_root(0), y_root(0), dx(0), dy(0), state(0)
+			, pending(false), replaying(false)
+		{}
+		double                x, y;           ///< Latest position (canvas drags)
+		double                x_root, y_root; ///< Latest root position (canvas drags)
+		double                dx, dy;         ///< Total motion (item drags)
+		guint                 state;          ///< Latest modifier state
+		boost::weak_ptr<Item> item;           ///< Dragged item (NULL for canvas drags)
+		bool                  pending;        ///< Motion has not been handled yet
+		bool                  replaying;      ///< Motion is being handled now
+	};
+	PendingMotion _motion;
+
+	boost::shared_ptr<Port> find_synced_port(const std::string& module_id,
+	                                         const std::string& port_id) const;
+	void remove_port_connections(Port& port);
+
+	bool post(const GraphCommand& command);
+	bool apply_control_stream();
+	void start_control_stream();
+	bool poll_control_stream();
+	bool apply_commands();
+	void poll_commands(unsigned interval_ms);
+	void apply_command(const GraphCommand& command, std::set< boost::shared_ptr<Module> >& dirty);
 
 	void ports_joined(boost::shared_ptr<Port> port1, boost::shared_ptr<Port> port2);
+	void ports_joined(boost::shared_ptr<Port> port1,
+	                  boost::shared_ptr<Port> port2,
+	                  ConnectablePairs&       to_connect,
+	                  ConnectablePairs&       to_disconnect);
+	void apply_joins(const ConnectablePairs& to_connect,
+	                 const ConnectablePairs& to_disconnect);
 	bool animate_selected();
+	void update_select_animation();
+	sigc::connection _select_animation;
+
+	void move_items(const ItemPositions& positions, ItemList& moved);
 
-	void move_contents_to_internal(double x, double y, double min_x, double min_y);
+	void record_operation(Operation op, uint64_t start_us, uint64_t dur_us);
+
+	void queue_frame();
+	bool on_frame();
+	bool animate_transition();
+	sigc::connection _frame_connection;
+	sigc::connection _command_connection;
+	sigc::connection _control_connection; ///< Checks for values while no frames run
 
 	void on_parent_changed(Gtk::Widget* old_parent);
 	sigc::connection _parent_event_connection;
 
+	void on_hierarchy_changed(Gtk::Widget* previous_toplevel);
+	bool toplevel_event(GdkEvent* ev);
+	bool on_visibility_notify_event(GdkEventVisibility* event);
+	void on_map();
+	void on_unmap();
+	sigc::connection _toplevel_event_connection;
+
 	typedef std::list< boost::shared_ptr<Port> > SelectedPorts;
 
+	GraphModel                     _model;
+	boost::shared_ptr<ObjectPools> _pools; ///< Allocation pools for objects
+	OperationStats _stats[N_OPERATIONS];
+
+	// Views of model objects, indexed by model ID
+	std::vector< boost::weak_ptr<Item> >       _item_views;
+	std::vector< boost::weak_ptr<Port> >       _port_views;
+	std::vector< boost::weak_ptr<Connection> > _edge_views;
+
 	SelectedPorts           _selected_ports; ///< Selected ports (hilited red)
 	boost::shared_ptr<Port> _connect_port;  ///< Port for which a connection is being made
 	boost::shared_ptr<Port> _last_selected_port;
 
 	Gnome::Canvas::Rect  _base_rect;   ///< Background
+	Gnome::Canvas::Group* _layers[N_LAYERS]; ///< Children of root(), bottom to top
 	Gnome::Canvas::Rect* _select_rect; ///< Rectangle for drag selection
 	ArtVpathDash*        _select_dash; ///< Animated selection dash style
+	LayoutCache*         _layout_cache; ///< Previous arrange() results
+	TraceBuffer*         _trace;        ///< Recorded operations (if ever traced)
+	Hud*                 _hud;          ///< Performance display (if shown)
+	SyncIndex*           _sync_index;   ///< Objects created by sync()
+	CommandQueue*        _commands;     ///< Commands from other threads (if enabled)
+	unsigned             _command_idle_frames; ///< Checks that found no commands
+	ControlStream*       _control_stream; ///< Streamed control values (if enabled)
+	unsigned             _control_idle_frames; ///< Frames with no new control values
+
+	ItemPositions _transition_from;  ///< Start positions of running animation
+	ItemPositions _transition_to;    ///< End positions of running animation
+	double        _transition_start; ///< Start time of running animation
+	double        _animation_duration;
 
 	double _zoom;   ///< Current zoom level
 	double _width;
@@ -197,6 +475,10 @@ private:
 
 	bool _remove_objects :1; // flag to avoid removing objects from destructors when unnecessary
 	bool _locked         :1;
+	bool _focused        :1; ///< Toplevel window has focus
+	bool _obscured       :1; ///< Unmapped or fully covered
+	bool _tracing        :1; ///< Recording operations into _trace
+	bool _control_hidden :1; ///< Streamed values wait for their port to be visible
 };
 
 
@@ -18,9 +18,14 @@
 #ifndef FLOWCANVAS_CONNECTABLE_HPP
 #define FLOWCANVAS_CONNECTABLE_HPP
 
-#include <list>
+#include <stdint.h>
+
+#include <map>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include "flowcanvas/SmallVector.hpp"
 
 namespace FlowCanvas {
 
@@ -28,10 +33,17 @@ class Connection;
 
 
 /** An object a Connection can connect to.
+ *
+ * Connections are kept in a flat vector.  Each connection records its index
+ * in the vector at either end, so adding and removing one is constant time,
+ * and connections remove themselves from both ends when destroyed so the
+ * vector never holds a dead one.  Connectables with many connections also
+ * keep a count of connections per peer for is_connected_to().
  */
 class Connectable {
 public:
-	virtual ~Connectable() {}
+	Connectable() : _peers(NULL) {}
+	virtual ~Connectable();
 
 	virtual Gnome::Art::Point src_connection_point() = 0;
 	virtual Gnome::Art::Point dst_connection_point(const Gnome::Art::Point& src) = 0;
@@ -45,11 +57,42 @@ public:
 
 	bool is_connected_to(boost::shared_ptr<Connectable> other);
 
-	typedef std::list< boost::weak_ptr<Connection> > Connections;
-	Connections& connections() { return _connections; }
+	/** Reference to a connection (a weak_ptr that also has the raw pointer,
+	 * which is valid while the connection is in connections()).
+	 */
+	class Ref : public boost::weak_ptr<Connection> {
+	public:
+		explicit Ref(const boost::shared_ptr<Connection>& c)
+			: boost::weak_ptr<Connection>(c), _ptr(c.get()) {}
+
+		Connection* get() const { return _ptr; }
+
+	private:
+		Connection* _ptr;
+	};
+
+	typedef SmallVector<Ref, 1> Connections;
+	const Connections& connections() const { return _connections; }
 
 protected:
+	friend class Connection;
+
+	void   clear_connections();
+	size_t connections_heap_bytes() const;
+
 	Connections _connections; ///< needed for dragging
+
+private:
+	typedef std::map<const Connectable*, uint32_t> Peers;
+
+	void detach(Connection* c, unsigned end);
+	void add_peer(const Connectable* peer);
+	void remove_peer(const Connectable* peer);
+
+	/** Degree at which the peer index is built (dropped below half that). */
+	static const size_t PEER_INDEX_DEGREE = 16;
+
+	Peers* _peers; ///< Number of connections per peer (high degree only)
 };
 
 
@@ -29,6 +29,9 @@
 #include <libgnomecanvasmm/bpath.h>
 #include <libgnomecanvasmm/path-def.h>
 
+#include "flowcanvas/GraphModel.hpp"
+#include "flowcanvas/MemoryReport.hpp"
+
 namespace FlowCanvas {
 
 class Canvas;
@@ -65,7 +68,7 @@ public:
 
 	void set_color(uint32_t color);
 	void set_highlighted(bool b);
-	void raise_to_top();
+	void set_raised(bool raised);
 
 	void select_tick();
 
@@ -80,6 +83,9 @@ public:
 
 	void set_handle_style(HandleStyle s) { _handle_style = s; }
 
+	/** Add the estimated memory used by this connection to @a report. */
+	virtual void account_memory(MemoryReport& report) const;
+
 protected:
 	friend class Canvas;
 	friend class Connectable;
@@ -104,8 +110,16 @@ protected:
 	uint32_t    _color;
 	HandleStyle _handle_style;
 
+	GraphModel::EdgeID _model_id; ///< ID in canvas model (NONE if not on canvas)
+
+	static const uint32_t NO_SLOT = 0xFFFFFFFF;
+
+	Connectable* _ends[2];  ///< Source and dest (for identity, see Connectable)
+	uint32_t     _slots[2]; ///< Index in connections() of each end, or NO_SLOT
+
 	bool _selected       :1;
 	bool _show_arrowhead :1;
+	bool _raised         :1; ///< In the highlighted layer
 };
 
 typedef std::list<boost::shared_ptr<Connection> > ConnectionList;
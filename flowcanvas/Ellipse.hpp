@@ -58,8 +58,6 @@ public:
 	virtual Gnome::Art::Point dst_connection_point(const Gnome::Art::Point& src);
 	virtual Gnome::Art::Point connection_point_vector(double dx, double dy);
 
-	void add_connection(boost::shared_ptr<Connection> c);
-
 	bool point_is_within(double x, double y);
 
 	void zoom(double z);
@@ -88,14 +86,17 @@ public:
 	void set_base_color(uint32_t c);
 	void set_default_base_color();
 
+	virtual void account_memory(MemoryReport& report) const;
+
 protected:
 	bool is_within(const Gnome::Canvas::Rect& rect);
 
 	double _border_width;
 	bool   _title_visible;
 
-	Gnome::Canvas::Ellipse _ellipse;
-	Gnome::Canvas::Text*   _label;
+	Gnome::Canvas::Ellipse  _ellipse;
+	Gnome::Canvas::Ellipse* _select_outline; ///< Animated border (if selected)
+	Gnome::Canvas::Text*    _label;
 };
 
 
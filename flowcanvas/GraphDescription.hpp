@@ -0,0 +1,91 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+#ifndef FLOWCANVAS_GRAPHDESCRIPTION_HPP
+#define FLOWCANVAS_GRAPHDESCRIPTION_HPP
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace FlowCanvas {
+
+
+/** A port in a GraphDescription.
+ *
+ * \ingroup FlowCanvas
+ */
+struct PortDescription {
+	PortDescription(const std::string& i, const std::string& n, bool input, uint32_t c)
+		: id(i), name(n), is_input(input), color(c) {}
+
+	std::string id;       ///< Identity within the module (stable across syncs)
+	std::string name;     ///< Displayed name (may change)
+	bool        is_input;
+	uint32_t    color;
+};
+
+
+/** A module in a GraphDescription.
+ *
+ * \ingroup FlowCanvas
+ */
+struct ModuleDescription {
+	ModuleDescription(const std::string& i, const std::string& n, double px=0, double py=0)
+		: id(i), name(n), x(px), y(py) {}
+
+	std::string                  id;    ///< Identity (stable across syncs)
+	std::string                  name;  ///< Displayed name (may change)
+	double                       x;     ///< Initial position (new modules only)
+	double                       y;
+	std::vector<PortDescription> ports;
+};
+
+
+/** A connection in a GraphDescription, between ports given by ID.
+ *
+ * \ingroup FlowCanvas
+ */
+struct ConnectionDescription {
+	ConnectionDescription(const std::string& tm, const std::string& tp,
+	                      const std::string& hm, const std::string& hp,
+	                      uint32_t c)
+		: tail_module(tm), tail_port(tp), head_module(hm), head_port(hp), color(c) {}
+
+	std::string tail_module;
+	std::string tail_port;
+	std::string head_module;
+	std::string head_port;
+	uint32_t    color;
+};
+
+
+/** A plain description of a whole graph, for Canvas::sync().
+ *
+ * \ingroup FlowCanvas
+ */
+struct GraphDescription {
+	std::vector<ModuleDescription>     modules;
+	std::vector<ConnectionDescription> connections;
+};
+
+
+} // namespace FlowCanvas
+
+#endif // FLOWCANVAS_GRAPHDESCRIPTION_HPP
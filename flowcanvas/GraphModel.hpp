@@ -0,0 +1,225 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef FLOWCANVAS_GRAPHMODEL_HPP
+#define FLOWCANVAS_GRAPHMODEL_HPP
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "flowcanvas/Symbol.hpp"
+
+namespace FlowCanvas {
+
+
+/** Headless graph state, independent of any toolkit.
+ *
+ * Items, ports and edges are stored in parallel arrays ("struct of arrays")
+ * indexed by small integer IDs, so the graph algorithms used by the Canvas
+ * (selection bookkeeping, layout input, hit testing and lookups) can be run,
+ * tested and profiled without a display or main loop.
+ *
+ * A Canvas owns a model, and the Canvas, Module, Port and Connection objects
+ * act as views of it: they keep it up to date as they change, and query it
+ * for anything that would otherwise mean scanning every object.
+ *
+ * Edges connect ports, or items directly (e.g. Ellipses), so an endpoint is
+ * an (item, port) pair where port is NONE for items.  IDs of removed objects
+ * are reused.
+ *
+ * \ingroup FlowCanvas
+ */
+class GraphModel {
+public:
+	typedef uint32_t ItemID;
+	typedef uint32_t PortID;
+	typedef uint32_t EdgeID;
+
+	static const uint32_t NONE = 0xFFFFFFFF;
+
+	enum ItemKind { ITEM, MODULE };
+
+	GraphModel();
+
+	void clear();
+
+	// Items
+
+	ItemID add_item(ItemKind kind, const Symbol& name,
+	                double x, double y, double w, double h);
+
+	void remove_item(ItemID item);
+
+	void set_item_name(ItemID item, const Symbol& name)  { _item_name[item] = name; }
+	void set_item_partner(ItemID item, ItemID partner)   { _item_partner[item] = partner; }
+	void set_item_geometry(ItemID item, double x, double y, double w, double h);
+
+	bool               item_valid(ItemID i) const { return i < _item_flags.size() && (_item_flags[i] & ALIVE); }
+	ItemKind           item_kind(ItemID i)  const { return (_item_flags[i] & IS_MODULE) ? MODULE : ITEM; }
+	const std::string& item_name(ItemID i)  const { return _item_name[i].str(); }
+	const Symbol&      item_symbol(ItemID i) const { return _item_name[i]; }
+	ItemID             item_partner(ItemID i) const { return _item_partner[i]; }
+	double             item_x(ItemID i)     const { return _item_x[i]; }
+	double             item_y(ItemID i)     const { return _item_y[i]; }
+	double             item_w(ItemID i)     const { return _item_w[i]; }
+	double             item_h(ItemID i)     const { return _item_h[i]; }
+
+	const std::vector<PortID>& item_ports(ItemID i) const { return _item_ports[i]; }
+	const std::vector<EdgeID>& item_edges(ItemID i) const { return _item_edges[i]; }
+
+	size_t num_items() const { return _num_items; }
+	size_t item_capacity() const { return _item_flags.size(); }
+
+	// Ports
+
+	PortID add_port(ItemID item, const Symbol& name, bool is_input);
+	void   remove_port(PortID port);
+
+	void set_port_name(PortID port, const Symbol& name) { _port_name[port] = name; }
+	void set_port_geometry(PortID port, double x, double y, double w, double h);
+
+	bool               port_valid(PortID p)    const { return p < _port_flags.size() && (_port_flags[p] & ALIVE); }
+	ItemID             port_item(PortID p)     const { return _port_item[p]; }
+	const std::string& port_name(PortID p)     const { return _port_name[p].str(); }
+	const Symbol&      port_symbol(PortID p)   const { return _port_name[p]; }
+	bool               port_is_input(PortID p) const { return _port_flags[p] & IS_INPUT; }
+	double             port_x(PortID p)        const { return _port_x[p]; }
+	double             port_y(PortID p)        const { return _port_y[p]; }
+	double             port_w(PortID p)        const { return _port_w[p]; }
+	double             port_h(PortID p)        const { return _port_h[p]; }
+
+	PortID find_port(ItemID item, const std::string& name) const;
+	PortID port_at(double x, double y) const;
+	void   port_edges(PortID port, std::vector<EdgeID>& edges) const;
+
+	size_t num_ports() const { return _num_ports; }
+
+	// Edges
+
+	EdgeID add_edge(ItemID tail_item, PortID tail_port, ItemID head_item, PortID head_port);
+	void   remove_edge(EdgeID edge);
+	EdgeID find_edge(ItemID tail_item, PortID tail_port, ItemID head_item, PortID head_port) const;
+
+	void set_edge_length_hint(EdgeID e, double length) { _edge_length[e] = length; }
+
+	bool   edge_valid(EdgeID e)     const { return e < _edge_flags.size() && (_edge_flags[e] & ALIVE); }
+	ItemID edge_tail_item(EdgeID e) const { return _edge_tail_item[e]; }
+	PortID edge_tail_port(EdgeID e) const { return _edge_tail_port[e]; }
+	ItemID edge_head_item(EdgeID e) const { return _edge_head_item[e]; }
+	PortID edge_head_port(EdgeID e) const { return _edge_head_port[e]; }
+	double edge_length_hint(EdgeID e) const { return _edge_length[e]; }
+
+	size_t num_edges() const { return _num_edges; }
+
+	// Selection
+
+	void select_item(ItemID item, std::vector<EdgeID>& selected_edges);
+	void unselect_item(ItemID item, std::vector<EdgeID>& unselected_edges);
+	void set_edge_selected(EdgeID edge, bool selected);
+	void clear_selection();
+
+	bool item_selected(ItemID i) const { return _item_flags[i] & SELECTED; }
+	bool edge_selected(EdgeID e) const { return _edge_flags[e] & SELECTED; }
+
+	void items_within(double x1, double y1, double x2, double y2,
+	                  std::vector<ItemID>& items) const;
+
+	size_t count_items_intersecting(double x1, double y1, double x2, double y2) const;
+
+	// Bounds
+
+	bool get_bounds(double& x1, double& y1, double& x2, double& y2);
+
+	// Layout
+
+	void     layout_order(std::vector<ItemID>& items) const;
+	uint64_t layout_key(const std::vector<ItemID>& items, uint32_t direction) const;
+
+	/** Return the estimated number of bytes used by this model. */
+	size_t memory_bytes() const;
+
+private:
+	enum Flags {
+		ALIVE     = 1 << 0,
+		IS_MODULE = 1 << 1,
+		IS_INPUT  = 1 << 2,
+		SELECTED  = 1 << 3
+	};
+
+	typedef std::pair<uint64_t, uint64_t> EdgeKey;
+
+	static inline uint64_t endpoint_key(ItemID item, PortID port) {
+		return (uint64_t(item) << 32) | port;
+	}
+
+	void edge_list_remove(std::vector<EdgeID>& edges, EdgeID edge);
+	void bounds_changed(double old_x1, double old_y1, double old_x2, double old_y2,
+	                    double x1, double y1, double x2, double y2);
+	void bounds_added(double x1, double y1, double x2, double y2);
+	void bounds_removed(double x1, double y1, double x2, double y2);
+
+	// Items
+	std::vector<uint8_t>               _item_flags;
+	std::vector<Symbol>                _item_name;
+	std::vector<double>                _item_x;
+	std::vector<double>                _item_y;
+	std::vector<double>                _item_w;
+	std::vector<double>                _item_h;
+	std::vector<ItemID>                _item_partner;
+	std::vector< std::vector<PortID> > _item_ports;
+	std::vector< std::vector<EdgeID> > _item_edges; ///< Edges to/from item or its ports
+	std::vector<ItemID>                _free_items;
+	size_t                             _num_items;
+
+	// Ports (geometry is relative to the item)
+	std::vector<uint8_t>     _port_flags;
+	std::vector<ItemID>      _port_item;
+	std::vector<Symbol>      _port_name;
+	std::vector<double>      _port_x;
+	std::vector<double>      _port_y;
+	std::vector<double>      _port_w;
+	std::vector<double>      _port_h;
+	std::vector<PortID>      _free_ports;
+	size_t                   _num_ports;
+
+	// Edges
+	std::vector<uint8_t>      _edge_flags;
+	std::vector<ItemID>       _edge_tail_item;
+	std::vector<PortID>       _edge_tail_port;
+	std::vector<ItemID>       _edge_head_item;
+	std::vector<PortID>       _edge_head_port;
+	std::vector<double>       _edge_length;
+	std::vector<EdgeID>       _free_edges;
+	std::map<EdgeKey, EdgeID> _edge_index;
+	size_t                    _num_edges;
+
+	// Bounding box of all items (if not dirty)
+	double _x1;
+	double _y1;
+	double _x2;
+	double _y2;
+	bool   _bounds_dirty;
+};
+
+
+} // namespace FlowCanvas
+
+#endif // FLOWCANVAS_GRAPHMODEL_HPP
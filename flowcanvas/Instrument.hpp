@@ -0,0 +1,88 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef FLOWCANVAS_INSTRUMENT_HPP
+#define FLOWCANVAS_INSTRUMENT_HPP
+
+#include <stdint.h>
+
+namespace FlowCanvas {
+
+
+/** An instrumented canvas operation.
+ *
+ * Statistics and traces of these are only collected if FlowCanvas was
+ * configured with --instrument, otherwise they are always empty.
+ *
+ * \ingroup FlowCanvas
+ */
+enum Operation {
+	OP_ADD_ITEM,
+	OP_REMOVE_ITEM,
+	OP_ADD_CONNECTION,
+	OP_REMOVE_CONNECTION,
+	OP_SELECT_ITEM,
+	OP_UNSELECT_ITEM,
+	OP_CLEAR_SELECTION,
+	OP_GET_PORT_AT,
+	OP_MOVE_ITEMS,
+	OP_UPDATE_CONNECTION,  ///< Connection::update_location
+	OP_RESIZE_MODULE,      ///< Module::resize_horiz and Module::resize_vert
+	OP_MEASURE_TEXT,       ///< Module::measure_ports
+	OP_SET_ZOOM,
+	OP_ARRANGE,
+	OP_LAYOUT,             ///< Running GraphViz (part of OP_ARRANGE)
+	OP_FRAME,              ///< Per-frame work (animation etc.)
+	OP_REPAINT,            ///< libgnomecanvas expose handling
+	OP_CANVAS_EVENT,       ///< Canvas::canvas_event
+	OP_PORT_EVENT,         ///< Canvas::port_event
+	OP_ITEM_EVENT,         ///< Item::on_event
+	OP_SYNC,               ///< Canvas::sync
+	OP_COMMANDS,           ///< Applying commands posted from other threads
+	N_OPERATIONS
+};
+
+
+/** Return a short readable name for @a op (e.g. "add_item"). */
+const char* operation_name(Operation op);
+
+
+/** Statistics for one instrumented Operation.
+ *
+ * Durations are in microseconds and include any nested operations.
+ *
+ * \ingroup FlowCanvas
+ */
+struct OperationStats {
+	OperationStats() : count(0), total_us(0), max_us(0) {}
+
+	inline void add(uint64_t us) {
+		++count;
+		total_us += us;
+		if (us > max_us)
+			max_us = us;
+	}
+
+	uint64_t count;
+	uint64_t total_us;
+	uint64_t max_us;
+};
+
+
+} // namespace FlowCanvas
+
+#endif // FLOWCANVAS_INSTRUMENT_HPP
@@ -28,6 +28,9 @@
 
 #include <libgnomecanvasmm.h>
 
+#include "flowcanvas/GraphModel.hpp"
+#include "flowcanvas/LazySignal.hpp"
+#include "flowcanvas/MemoryReport.hpp"
 #include "flowcanvas/Port.hpp"
 
 namespace FlowCanvas {
@@ -84,14 +87,17 @@ public:
 
 	virtual void resize() = 0;
 
+	void update_bounds();
+
 	virtual void load_location()  {}
 	virtual void store_location() {}
 
 	bool        is_within(const Gnome::Canvas::Rect& rect) const;
 	inline bool point_is_within(double x, double y) const;
 
-	const std::string& name() const                   { return _name; }
-	virtual void       set_name(const std::string& n) { _name = n; }
+	const std::string& name()   const                 { return _name.str(); }
+	const Symbol&      symbol() const                 { return _name; }
+	virtual void       set_name(const std::string& n) { _name = n; name_changed(); }
 
 	uint32_t     base_color() const           { return _color; }
 	virtual void set_border_color(uint32_t c) { _border_color = c; }
@@ -109,26 +115,41 @@ public:
 	void set_partner(boost::shared_ptr<Item> partner) { _partner = partner; }
 	boost::weak_ptr<Item> partner()                   { return _partner; }
 
-	sigc::signal<void> signal_pointer_entered;
-	sigc::signal<void> signal_pointer_exited;
-	sigc::signal<void> signal_selected;
-	sigc::signal<void> signal_unselected;
+	/** Add the estimated memory used by this item to @a report.
+	 * Subclasses with significant state of their own should override this.
+	 */
+	virtual void account_memory(MemoryReport& report) const;
+
+	LazySignal< sigc::signal<void> > signal_pointer_entered;
+	LazySignal< sigc::signal<void> > signal_pointer_exited;
+	LazySignal< sigc::signal<void> > signal_selected;
+	LazySignal< sigc::signal<void> > signal_unselected;
 
-	sigc::signal<void, GdkEventButton*> signal_clicked;
-	sigc::signal<void, GdkEventButton*> signal_double_clicked;
+	LazySignal< sigc::signal<void, GdkEventButton*> > signal_clicked;
+	LazySignal< sigc::signal<void, GdkEventButton*> > signal_double_clicked;
 
-	sigc::signal<void, double, double> signal_dragged;
-	sigc::signal<void, double, double> signal_dropped;
+	LazySignal< sigc::signal<void, double, double> > signal_dragged;
+	LazySignal< sigc::signal<void, double, double> > signal_dropped;
 
 protected:
+	friend class Canvas;
+
 	virtual void on_drag(double dx, double dy);
 	virtual void on_drop();
+
+	/** Apply the drag motion since the last frame (called by the canvas). */
+	void drag_by(double dx, double dy) { on_drag(dx, dy); }
+
 	virtual void on_click(GdkEventButton* ev);
 	virtual void on_double_click(GdkEventButton* ev);
 
 	virtual void set_height(double h) = 0;
 	virtual void set_width(double w) = 0;
-	
+
+	void name_changed();
+
+	void account_item_memory(MemoryUsage& usage, size_t object_bytes) const;
+
 	bool on_event(GdkEvent* event);
 
 	const boost::weak_ptr<Canvas> _canvas;
@@ -136,13 +157,16 @@ protected:
 	boost::weak_ptr<Item> _partner;
 
 	Gtk::Menu*  _menu;
-	std::string _name;
+	Symbol      _name;
 	double      _minimum_width;
 	double      _width;
 	double      _height;
 	uint32_t    _border_color;
 	uint32_t    _color;
-	bool        _selected :1;
+
+	GraphModel::ItemID _model_id; ///< ID in canvas model (NONE if not on canvas)
+
+	bool _selected :1;
 };
 
 
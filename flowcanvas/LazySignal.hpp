@@ -0,0 +1,97 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef FLOWCANVAS_LAZYSIGNAL_HPP
+#define FLOWCANVAS_LAZYSIGNAL_HPP
+
+#include <cstddef>
+
+#include <sigc++/sigc++.h>
+
+namespace FlowCanvas {
+
+
+/** A sigc::signal that is only created when something connects to it.
+ *
+ * Canvas objects have many signals, most of which are never connected, so
+ * this keeps only a pointer in each object.  Emitting a signal that has never
+ * been connected is a single test.  The interface is the commonly used part of
+ * sigc::signal, and the real signal is available via signal() or an implicit
+ * conversion where one is needed.
+ *
+ * \ingroup FlowCanvas
+ */
+template<typename S>
+class LazySignal {
+public:
+	typedef S                           signal_type;
+	typedef typename S::result_type     result_type;
+	typedef typename S::slot_type       slot_type;
+	typedef typename S::iterator        iterator;
+
+	LazySignal() : _signal(NULL) {}
+	~LazySignal() { delete _signal; }
+
+	/** Return the underlying signal, creating it if necessary. */
+	S& signal() {
+		if (!_signal)
+			_signal = new S();
+		return *_signal;
+	}
+
+	operator S&() { return signal(); }
+
+	iterator  connect(const slot_type& slot) { return signal().connect(slot); }
+	slot_type make_slot()                    { return signal().make_slot(); }
+
+	bool   empty() const { return !_signal || _signal->empty(); }
+	size_t size()  const { return _signal ? _signal->size() : 0; }
+	void   clear()       { if (_signal) _signal->clear(); }
+
+	result_type emit() const {
+		return _signal ? _signal->emit() : result_type();
+	}
+
+	template<typename A1>
+	result_type emit(const A1& a1) const {
+		return _signal ? _signal->emit(a1) : result_type();
+	}
+
+	template<typename A1, typename A2>
+	result_type emit(const A1& a1, const A2& a2) const {
+		return _signal ? _signal->emit(a1, a2) : result_type();
+	}
+
+	result_type operator()() const { return emit(); }
+
+	template<typename A1>
+	result_type operator()(const A1& a1) const { return emit(a1); }
+
+	template<typename A1, typename A2>
+	result_type operator()(const A1& a1, const A2& a2) const { return emit(a1, a2); }
+
+private:
+	LazySignal(const LazySignal&);
+	LazySignal& operator=(const LazySignal&);
+
+	S* _signal;
+};
+
+
+} // namespace FlowCanvas
+
+#endif // FLOWCANVAS_LAZYSIGNAL_HPP
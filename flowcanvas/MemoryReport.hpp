@@ -0,0 +1,102 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef FLOWCANVAS_MEMORYREPORT_HPP
+#define FLOWCANVAS_MEMORYREPORT_HPP
+
+#include <stddef.h>
+
+namespace FlowCanvas {
+
+
+/** A category of objects in a MemoryReport.
+ *
+ * \ingroup FlowCanvas
+ */
+enum MemoryCategory {
+	MEM_MODULES,
+	MEM_ITEMS,        ///< Items other than modules
+	MEM_PORTS,
+	MEM_CONNECTIONS,
+	MEM_MODEL,        ///< Canvas GraphModel
+	MEM_CANVAS,       ///< Canvas object and its item lists and tables
+	N_MEMORY_CATEGORIES
+};
+
+
+/** Return a short readable name for @a category (e.g. "modules"). */
+const char* memory_category_name(MemoryCategory category);
+
+
+/** Estimated memory used by objects of one category.
+ *
+ * Object bytes are the C++ objects themselves (including embedded signals and
+ * canvas item wrappers), their shared_ptr counts, and the strings and
+ * containers they own.  GObject bytes are the instance sizes of their canvas
+ * items and menus.  Text bytes are the Pango layouts and text buffers of their
+ * labels.  Slots connected to signals and memory inside GTK or Pango that is
+ * not reachable from a public field are not counted.
+ *
+ * \ingroup FlowCanvas
+ */
+struct MemoryUsage {
+	MemoryUsage() : count(0), object_bytes(0), gobject_bytes(0), text_bytes(0) {}
+
+	inline size_t total_bytes() const {
+		return object_bytes + gobject_bytes + text_bytes;
+	}
+
+	inline void add(const MemoryUsage& usage) {
+		count         += usage.count;
+		object_bytes  += usage.object_bytes;
+		gobject_bytes += usage.gobject_bytes;
+		text_bytes    += usage.text_bytes;
+	}
+
+	size_t count;
+	size_t object_bytes;
+	size_t gobject_bytes;
+	size_t text_bytes;
+};
+
+
+/** Estimated memory used by a Canvas and everything on it.
+ *
+ * \see Canvas::memory_report
+ * \ingroup FlowCanvas
+ */
+struct MemoryReport {
+	MemoryReport() : pool_bytes(0) {}
+
+	MemoryUsage&       operator[](MemoryCategory c)       { return usage[c]; }
+	const MemoryUsage& operator[](MemoryCategory c) const { return usage[c]; }
+
+	MemoryUsage total() const;
+
+	MemoryUsage usage[N_MEMORY_CATEGORIES];
+
+	/** Bytes currently handed out from the canvas' object pools.  This
+	 * overlaps the categories (pooled objects are also counted there), so it
+	 * is not part of total().
+	 */
+	size_t pool_bytes;
+};
+
+
+} // namespace FlowCanvas
+
+#endif // FLOWCANVAS_MEMORYREPORT_HPP
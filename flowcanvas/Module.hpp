@@ -49,10 +49,15 @@ public:
 	const PortVector& ports() const { return _ports; }
 	PortVector&       ports()       { return _ports; }
 
+	inline boost::shared_ptr<Port> get_port(const Symbol& name) const;
 	inline boost::shared_ptr<Port> get_port(const std::string& name) const;
+	inline boost::shared_ptr<Port> get_port(const char* name) const {
+		return get_port(std::string(name));
+	}
 
 	void                    add_port(boost::shared_ptr<Port> port);
 	void                    remove_port(boost::shared_ptr<Port> port);
+	void                    remove_ports(const PortVector& ports);
 	boost::shared_ptr<Port> port_at(double x, double y);
 
 	void zoom(double z);
@@ -81,6 +86,8 @@ public:
 
 	size_t num_ports() const { return _ports.size(); }
 
+	virtual void account_memory(MemoryReport& report) const;
+
 	double empty_port_breadth() const;
 	double empty_port_depth() const;
 
@@ -94,8 +101,10 @@ protected:
 	void measure_ports();
 	void resize_horiz();
 	void resize_vert();
+	void update_port_models();
+	void update_port_model(const Port& port);
 
-	void port_renamed() { _port_renamed = true; }
+	void port_renamed(const Port& port) { _port_renamed = true; update_port_model(port); }
 
 	void embed(Gtk::Container* widget);
 
@@ -104,6 +113,7 @@ protected:
 	Gnome::Canvas::Rect    _module_box;
 	Gnome::Canvas::Text    _canvas_title;
 	Gnome::Canvas::Rect*   _stacked_border;
+	Gnome::Canvas::Rect*   _select_outline; ///< Animated border (if selected)
 	Gnome::Canvas::Pixbuf* _icon_box;
 	Gtk::Container*        _embed_container;
 	Gnome::Canvas::Widget* _embed_item;
@@ -122,12 +132,13 @@ protected:
 
 private:
 	friend class Canvas;
+	friend class Port;
 
 	struct PortComparator {
-		explicit PortComparator(const std::string& name) : _name(name) {}
-		inline bool operator()(const boost::shared_ptr<Port> port)
-			{ return (port && port->name() == _name); }
-		const std::string& _name;
+		explicit PortComparator(const Symbol& name) : _name(name) {}
+		inline bool operator()(const boost::shared_ptr<Port>& port)
+			{ return (port && port->symbol() == _name); }
+		const Symbol& _name;
 	};
 
 	void embed_size_request(Gtk::Requisition* req, bool force);
@@ -140,7 +151,7 @@ private:
 
 /** Find a port on this module. */
 inline boost::shared_ptr<Port>
-Module::get_port(const std::string& port_name) const
+Module::get_port(const Symbol& port_name) const
 {
 	PortComparator comp(port_name);
 	PortVector::const_iterator i = std::find_if(_ports.begin(), _ports.end(), comp);
@@ -148,6 +159,19 @@ Module::get_port(const std::string& port_name) const
 }
 
 
+/** Find a port on this module. */
+inline boost::shared_ptr<Port>
+Module::get_port(const std::string& port_name) const
+{
+	// No port can have a name that is not interned
+	const Symbol symbol = Symbol::find(port_name);
+	if (symbol.empty() && !port_name.empty())
+		return boost::shared_ptr<Port>();
+
+	return get_port(symbol);
+}
+
+
 } // namespace FlowCanvas
 
 #endif // FLOWCANVAS_MODULE_HPP
@@ -0,0 +1,128 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+#ifndef FLOWCANVAS_POOLALLOCATOR_HPP
+#define FLOWCANVAS_POOLALLOCATOR_HPP
+
+#include <cstddef>
+#include <limits>
+#include <new>
+
+#include <boost/pool/poolfwd.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+
+namespace FlowCanvas {
+
+
+/** Pools of fixed size blocks for the objects on one canvas.
+ *
+ * Requests are rounded up to a multiple of GRANULARITY and served from a
+ * boost::pool for that size, so objects of the same type sit together in
+ * large chunks and allocation is a free list pop.  Requests larger than
+ * MAX_SIZE go to operator new.  All chunks are released at once when the
+ * pools are destroyed.  Not thread safe (canvas objects live in the GUI
+ * thread).
+ *
+ * \ingroup FlowCanvas
+ */
+class ObjectPools : boost::noncopyable {
+public:
+	ObjectPools();
+	~ObjectPools();
+
+	void* allocate(size_t size);
+	void  deallocate(void* ptr, size_t size);
+
+	/** Return the number of bytes currently handed out from pools. */
+	size_t live_bytes() const { return _live_bytes; }
+
+	static const size_t GRANULARITY = 16;
+	static const size_t MAX_SIZE    = 1024;
+
+private:
+	typedef boost::pool<boost::default_user_allocator_new_delete> Pool;
+
+	Pool*  _pools[MAX_SIZE / GRANULARITY];
+	size_t _live_bytes;
+};
+
+
+/** Standard allocator that allocates from a canvas' ObjectPools.
+ *
+ * Use with boost::allocate_shared to put an object and its reference count
+ * in the same pooled block, e.g.:
+ *
+ * \code
+ * boost::shared_ptr<Port> p = boost::allocate_shared<Port>(
+ *     canvas->allocator<Port>(), module, "in", true, 0xFF0000FF);
+ * \endcode
+ *
+ * The allocator holds a reference to the pools, so they outlive the canvas
+ * if objects allocated from them are still in use.
+ *
+ * \ingroup FlowCanvas
+ */
+template<typename T>
+class PoolAllocator {
+public:
+	typedef T              value_type;
+	typedef T*             pointer;
+	typedef const T*       const_pointer;
+	typedef T&             reference;
+	typedef const T&       const_reference;
+	typedef std::size_t    size_type;
+	typedef std::ptrdiff_t difference_type;
+
+	template<typename U> struct rebind { typedef PoolAllocator<U> other; };
+
+	explicit PoolAllocator(const boost::shared_ptr<ObjectPools>& pools) : _pools(pools) {}
+
+	template<typename U>
+	PoolAllocator(const PoolAllocator<U>& other) : _pools(other.pools()) {}
+
+	pointer allocate(size_type n, const void* hint=0) {
+		return static_cast<pointer>(_pools->allocate(n * sizeof(T)));
+	}
+
+	void deallocate(pointer p, size_type n) { _pools->deallocate(p, n * sizeof(T)); }
+
+	void construct(pointer p, const T& val) { new (p) T(val); }
+	void destroy(pointer p)                 { p->~T(); }
+
+	pointer       address(reference r) const       { return &r; }
+	const_pointer address(const_reference r) const { return &r; }
+
+	size_type max_size() const { return std::numeric_limits<size_type>::max() / sizeof(T); }
+
+	const boost::shared_ptr<ObjectPools>& pools() const { return _pools; }
+
+	template<typename U>
+	bool operator==(const PoolAllocator<U>& other) const { return _pools == other.pools(); }
+
+	template<typename U>
+	bool operator!=(const PoolAllocator<U>& other) const { return _pools != other.pools(); }
+
+private:
+	boost::shared_ptr<ObjectPools> _pools;
+};
+
+
+} // namespace FlowCanvas
+
+#endif // FLOWCANVAS_POOLALLOCATOR_HPP
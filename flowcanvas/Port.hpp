@@ -31,6 +31,10 @@
 #include <libgnomecanvasmm.h>
 
 #include "flowcanvas/Connectable.hpp"
+#include "flowcanvas/GraphModel.hpp"
+#include "flowcanvas/LazySignal.hpp"
+#include "flowcanvas/MemoryReport.hpp"
+#include "flowcanvas/Symbol.hpp"
 
 namespace FlowCanvas {
 
@@ -99,7 +103,8 @@ public:
 
 	double natural_width() const;
 
-	const std::string& name() const { return _name; }
+	const std::string& name()   const { return _name.str(); }
+	const Symbol&      symbol() const { return _name; }
 	virtual void       set_name(const std::string& n);
 
 	bool     is_input()  const { return _is_input; }
@@ -112,6 +117,7 @@ public:
 	virtual void toggle(bool signal=true);
 
 	virtual void set_control(float value, bool signal=true);
+	bool         stream_control(float value, bool visible, double min_dx);
 	virtual void set_control_min(float min);
 	virtual void set_control_max(float max);
 
@@ -122,18 +128,25 @@ public:
 	void show_control();
 	void hide_control();
 
-	inline bool operator==(const std::string& name) { return (_name == name); }
+	inline bool operator==(const std::string& name) { return (_name.str() == name); }
 
-	sigc::signal<void>       signal_renamed;
-	sigc::signal<void,float> signal_control_changed;
+	/** Add the estimated memory used by this port to @a report. */
+	virtual void account_memory(MemoryReport& report) const;
+
+	LazySignal< sigc::signal<void> >       signal_renamed;
+	LazySignal< sigc::signal<void,float> > signal_control_changed;
 
 protected:
 	friend class Canvas;
+	friend class Module;
 
 	void on_menu_hide();
 
+	double control_gauge_width(float& value);
+	void   draw_control(double w);
+
 	boost::weak_ptr<Module> _module;
-	std::string             _name;
+	Symbol                  _name;
 	Gnome::Canvas::Text*    _label;
 	Gnome::Canvas::Rect*    _rect;
 	Gtk::Menu*              _menu;
@@ -145,6 +158,7 @@ protected:
 			, value(0.0f)
 			, min(0.0f)
 			, max(1.0f)
+			, width(0.0)
 			{}
 
 		~Control() {
@@ -155,15 +169,18 @@ protected:
 		float                value;
 		float                min;
 		float                max;
+		double               width; ///< Gauge width as last drawn
 	};
 
 	Control* _control;
 	
-	double   _width;
-	double   _height;
-	double   _border_width;
+	float    _width;
+	float    _height;
+	float    _border_width;
 	uint32_t _color;
-	
+
+	GraphModel::PortID _model_id; ///< ID in canvas model (NONE if not on canvas)
+
 	bool _is_input :1;
 	bool _selected :1;
 	bool _toggled  :1;
@@ -0,0 +1,158 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef FLOWCANVAS_SMALLVECTOR_HPP
+#define FLOWCANVAS_SMALLVECTOR_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <new>
+
+namespace FlowCanvas {
+
+
+/** A vector that stores up to @a N elements without allocating.
+ *
+ * Meant for the many small per-object lists on a canvas (most ports have
+ * zero or one connection).  Only the operations FlowCanvas needs are
+ * provided.  Iterators are plain pointers, and like std::vector they are
+ * invalidated by any insertion or removal.
+ *
+ * \ingroup FlowCanvas
+ */
+template<typename T, unsigned N>
+class SmallVector {
+public:
+	typedef T         value_type;
+	typedef T*        iterator;
+	typedef const T*  const_iterator;
+	typedef size_t    size_type;
+
+	SmallVector() : _size(0), _capacity(N) {}
+
+	SmallVector(const SmallVector& other) : _size(0), _capacity(N) {
+		reserve(other._size);
+		for (const_iterator i = other.begin(); i != other.end(); ++i)
+			push_back(*i);
+	}
+
+	~SmallVector() {
+		clear();
+		if (on_heap())
+			::operator delete(_u.heap);
+	}
+
+	SmallVector& operator=(const SmallVector& other) {
+		if (&other != this) {
+			clear();
+			reserve(other._size);
+			for (const_iterator i = other.begin(); i != other.end(); ++i)
+				push_back(*i);
+		}
+		return *this;
+	}
+
+	iterator       begin()       { return data(); }
+	iterator       end()         { return data() + _size; }
+	const_iterator begin() const { return data(); }
+	const_iterator end()   const { return data() + _size; }
+
+	size_type size()     const { return _size; }
+	size_type capacity() const { return _capacity; }
+	bool      empty()    const { return _size == 0; }
+
+	T&       operator[](size_type i)       { return data()[i]; }
+	const T& operator[](size_type i) const { return data()[i]; }
+
+	T&       back()       { return data()[_size - 1]; }
+	const T& back() const { return data()[_size - 1]; }
+
+	void push_back(const T& value) {
+		if (_size == _capacity) {
+			const T copy(value); // value may be an element
+			reserve(_capacity * 2);
+			new (data() + _size) T(copy);
+		} else {
+			new (data() + _size) T(value);
+		}
+		++_size;
+	}
+
+	/** Remove the element at @a pos, keeping the order of the rest. */
+	iterator erase(iterator pos) {
+		iterator last = end() - 1;
+		for (iterator i = pos; i != last; ++i)
+			*i = *(i + 1);
+		last->~T();
+		--_size;
+		return pos;
+	}
+
+	void pop_back() {
+		back().~T();
+		--_size;
+	}
+
+	/** Remove all elements (keeping any allocated storage). */
+	void clear() {
+		for (iterator i = begin(); i != end(); ++i)
+			i->~T();
+		_size = 0;
+	}
+
+	void reserve(size_type n) {
+		if (n <= _capacity)
+			return;
+
+		T* const buf = static_cast<T*>(::operator new(n * sizeof(T)));
+		T* const old = data();
+		for (uint32_t i = 0; i < _size; ++i) {
+			new (buf + i) T(old[i]);
+			old[i].~T();
+		}
+		if (on_heap())
+			::operator delete(old);
+
+		_u.heap   = buf;
+		_capacity = uint32_t(n);
+	}
+
+	/** Return the number of bytes allocated outside the object. */
+	size_t heap_bytes() const { return on_heap() ? _capacity * sizeof(T) : 0; }
+
+private:
+	bool on_heap() const { return _capacity > N; }
+
+	T*       data()       { return on_heap() ? _u.heap : reinterpret_cast<T*>(_u.local); }
+	const T* data() const { return on_heap() ? _u.heap : reinterpret_cast<const T*>(_u.local); }
+
+	union {
+		T*     heap;
+		char   local[N * sizeof(T)];
+		void*  align_pointer;
+		double align_double;
+	} _u;
+
+	uint32_t _size;
+	uint32_t _capacity;
+};
+
+
+} // namespace FlowCanvas
+
+#endif // FLOWCANVAS_SMALLVECTOR_HPP
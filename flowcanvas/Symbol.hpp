@@ -0,0 +1,84 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef FLOWCANVAS_SYMBOL_HPP
+#define FLOWCANVAS_SYMBOL_HPP
+
+#include <stddef.h>
+
+#include <string>
+#include <utility>
+
+namespace FlowCanvas {
+
+
+/** An interned string.
+ *
+ * Equal symbols share a single copy of their string, so a symbol is the size
+ * of a pointer and comparing symbols is a pointer comparison.  Interned
+ * strings are reference counted and freed with the last symbol for them, so
+ * renaming things does not grow the table forever.  Symbols may only be
+ * used from the GUI thread (the counts are not atomic).
+ *
+ * \ingroup FlowCanvas
+ */
+class Symbol {
+public:
+	Symbol();
+	Symbol(const std::string& str);
+	Symbol(const char* str);
+
+	Symbol(const Symbol& s) : _entry(s._entry) { ++_entry->second; }
+	~Symbol() { if (--_entry->second == 0) release(_entry); }
+
+	Symbol& operator=(const Symbol& s) {
+		++s._entry->second;
+		if (--_entry->second == 0)
+			release(_entry);
+		_entry = s._entry;
+		return *this;
+	}
+
+	/** Return the symbol for @a str if it is interned, otherwise an empty symbol.
+	 * Unlike the constructor, this never adds to the table.
+	 */
+	static Symbol find(const std::string& str);
+
+	/** Return the estimated number of bytes used by all interned strings. */
+	static size_t table_bytes();
+
+	const std::string& str()   const { return _entry->first; }
+	bool               empty() const { return _entry->first.empty(); }
+
+	inline bool operator==(const Symbol& s) const { return _entry == s._entry; }
+	inline bool operator!=(const Symbol& s) const { return _entry != s._entry; }
+	inline bool operator<(const Symbol& s)  const { return _entry->first < s._entry->first; }
+
+private:
+	typedef std::pair<const std::string, unsigned> Entry; ///< String and reference count
+
+	explicit Symbol(Entry* entry) : _entry(entry) { ++_entry->second; }
+
+	static void release(Entry* entry);
+
+	Entry* _entry;
+};
+
+
+} // namespace FlowCanvas
+
+#endif // FLOWCANVAS_SYMBOL_HPP
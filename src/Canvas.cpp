@@ -18,20 +18,37 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <list>
+#include <locale>
 #include <map>
+#include <set>
 #include <sstream>
 #include <string>
 #include <vector>
 
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/make_shared.hpp>
 
 #include "flowcanvas-config.h"
 #include "flowcanvas/Canvas.hpp"
 #include "flowcanvas/Module.hpp"
 #include "flowcanvas/Port.hpp"
 
+#include "Clock.hpp"
+#include "CommandQueue.hpp"
+#include "ControlStream.hpp"
+#include "DragAnchor.hpp"
+#include "Hud.hpp"
+#include "LayoutCache.hpp"
+#include "MemoryAccounting.hpp"
+#include "SnapIndex.hpp"
+#include "SyncIndex.hpp"
+#include "ScopedOperation.hpp"
+#include "TraceBuffer.hpp"
+
 #ifdef HAVE_AGRAPH
 #include <gvc.h>
 #endif
@@ -44,13 +61,32 @@ using std::vector;
 
 namespace FlowCanvas {
 
+static const unsigned FRAME_INTERVAL_MS = 16; ///< Approximately 60 FPS
+static const uint64_t COMMAND_BUDGET_US = 4000; ///< Time per frame for posted commands
+static const unsigned COMMAND_IDLE_FRAMES = 30; ///< Empty checks before polling slowly
+static const unsigned CONTROL_IDLE_FRAMES = 30; ///< Idle frames before polling slowly
+static const unsigned IDLE_POLL_MS        = 100; ///< Slow polling interval for other threads
+static const unsigned SELECT_INTERVAL_MS = 300; ///< Selection dash animation step
+static const double   SNAP_DISTANCE_PX   = 4.0; ///< Snap to ports this close to the pointer
+
 sigc::signal<void, Gnome::Canvas::Item*> Canvas::signal_item_entered;
 sigc::signal<void, Gnome::Canvas::Item*> Canvas::signal_item_left;
 
 Canvas::Canvas(double width, double height)
-	: _base_rect(*root(), 0, 0, width, height)
+	: _pools(new ObjectPools())
+	, _base_rect(*root(), 0, 0, width, height)
 	, _select_rect(NULL)
 	, _select_dash(NULL)
+	, _layout_cache(new LayoutCache())
+	, _trace(NULL)
+	, _hud(NULL)
+	, _sync_index(NULL)
+	, _commands(NULL)
+	, _command_idle_frames(0)
+	, _control_stream(NULL)
+	, _control_idle_frames(0)
+	, _transition_start(0.0)
+	, _animation_duration(0.0)
 	, _zoom(1.0)
 	, _width(width)
 	, _height(height)
@@ -58,10 +94,18 @@ Canvas::Canvas(double width, double height)
 	, _direction(HORIZONTAL)
 	, _remove_objects(true)
 	, _locked(false)
+	, _focused(true)
+	, _obscured(false)
+	, _tracing(false)
+	, _control_hidden(false)
 {
 	set_scroll_region(0.0, 0.0, width, height);
 	set_center_scroll_region(true);
 
+	// Above _base_rect, which is the first child of root
+	for (unsigned i = 0; i < N_LAYERS; ++i)
+		_layers[i] = new Gnome::Canvas::Group(*root(), 0, 0);
+
 	_base_rect.property_fill_color_rgba() = 0x000000FF;
 	//_base_rect.show();
 	_base_rect.signal_event().connect(sigc::mem_fun(this, &Canvas::scroll_drag_handler));
@@ -78,16 +122,28 @@ Canvas::Canvas(double width, double height)
 	_select_dash->dash[0] = 5;
 	_select_dash->dash[1] = 5;
 
-	Glib::signal_timeout().connect(
-		sigc::mem_fun(this, &Canvas::animate_selected), 300);
+	add_events(Gdk::VISIBILITY_NOTIFY_MASK);
 }
 
 
 Canvas::~Canvas()
 {
+	_frame_connection.disconnect();
+	_command_connection.disconnect();
+	_control_connection.disconnect();
+	_select_animation.disconnect();
+	_toplevel_event_connection.disconnect();
 	destroy();
 	art_free(_select_dash->dash);
 	delete _select_dash;
+	delete _hud;
+	delete _sync_index;
+	delete _commands;
+	delete _control_stream;
+	delete _layout_cache;
+	delete _trace;
+	for (unsigned i = N_LAYERS; i > 0; --i)
+		delete _layers[i - 1];
 }
 
 
@@ -106,6 +162,8 @@ Canvas::lock(bool l)
 void
 Canvas::set_zoom(double pix_per_unit)
 {
+	FLOWCANVAS_INSTRUMENT_SCOPE(this, OP_SET_ZOOM);
+
 	if (_zoom == pix_per_unit)
 		return;
 
@@ -117,6 +175,9 @@ Canvas::set_zoom(double pix_per_unit)
 
 	for (list<boost::shared_ptr<Connection> >::iterator c = _connections.begin(); c != _connections.end(); ++c)
 		(*c)->zoom(_zoom);
+
+	if (_hud)
+		_hud->place();
 }
 
 
@@ -138,52 +199,154 @@ Canvas::scroll_to_center()
 void
 Canvas::zoom_full()
 {
-	if (_items.empty())
+	double left, top, right, bottom;
+	if (!get_contents_bounds(left, top, right, bottom))
 		return;
 
 	int win_width, win_height;
 	Glib::RefPtr<Gdk::Window> win = get_window();
 	win->get_size(win_width, win_height);
 
-	// Box containing all canvas items
-	double left   = DBL_MAX;
-	double right  = DBL_MIN;
-	double top    = DBL_MIN;
-	double bottom = DBL_MAX;
-
-	for (ItemList::iterator m = _items.begin(); m != _items.end(); ++m) {
-		const boost::shared_ptr<Item> mod = (*m);
-		if (!mod)
-			continue;
-
-		if (mod->property_x() < left)
-			left = mod->property_x();
-		if (mod->property_x() + mod->width() > right)
-			right = mod->property_x() + mod->width();
-		if (mod->property_y() < bottom)
-			bottom = mod->property_y();
-		if (mod->property_y() + mod->height() > top)
-			top = mod->property_y() + mod->height();
-	}
-
 	static const double pad = 8.0;
 
 	const double new_zoom = std::min(
 		((double)win_width / (double)(right - left + pad*2.0)),
-		((double)win_height / (double)(top - bottom + pad*2.0)));
+		((double)win_height / (double)(bottom - top + pad*2.0)));
 
 	set_zoom(new_zoom);
 
 	int scroll_x, scroll_y;
-	w2c(lrintf(left - pad), lrintf(bottom - pad), scroll_x, scroll_y);
+	w2c(lrintf(left - pad), lrintf(top - pad), scroll_x, scroll_y);
 
 	scroll_to(scroll_x, scroll_y);
 }
 
 
+/** Get the bounding box of all items on the canvas (in world units).
+ *
+ * Returns false if there are no items.
+ */
+bool
+Canvas::get_contents_bounds(double& x1, double& y1, double& x2, double& y2)
+{
+	return _model.get_bounds(x1, y1, x2, y2);
+}
+
+
+bool
+Canvas::instrumented()
+{
+#ifdef FLOWCANVAS_INSTRUMENT
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+void
+Canvas::reset_operation_stats()
+{
+	for (unsigned i = 0; i < N_OPERATIONS; ++i)
+		_stats[i] = OperationStats();
+}
+
+
+MemoryReport
+Canvas::memory_report() const
+{
+	MemoryReport report;
+
+	for (ItemList::const_iterator i = _items.begin(); i != _items.end(); ++i)
+		(*i)->account_memory(report);
+
+	for (ConnectionList::const_iterator c = _connections.begin(); c != _connections.end(); ++c)
+		(*c)->account_memory(report);
+
+	MemoryUsage& model = report[MEM_MODEL];
+	model.count        = 1;
+	model.object_bytes = _model.memory_bytes();
+
+	// Measured, unlike the estimates above (which include the pooled objects)
+	report.pool_bytes = _pools->live_bytes();
+
+	MemoryUsage& canvas = report[MEM_CANVAS];
+	canvas.count        = 1;
+	canvas.object_bytes = sizeof(Canvas)
+		+ list_heap_bytes(_items) + list_heap_bytes(_connections)
+		+ list_heap_bytes(_selected_items) + list_heap_bytes(_selected_connections)
+		+ list_heap_bytes(_selected_ports)
+		+ vector_heap_bytes(_item_views) + vector_heap_bytes(_port_views)
+		+ vector_heap_bytes(_edge_views)
+		+ map_heap_bytes(_transition_from) + map_heap_bytes(_transition_to)
+		+ (_layout_cache ? _layout_cache->memory_bytes() : 0)
+		+ (_trace ? _trace->memory_bytes() : 0)
+		+ (_hud ? sizeof(Hud) : 0)
+		+ (_sync_index ? _sync_index->memory_bytes() : 0)
+		+ (_commands ? _commands->memory_bytes() : 0)
+		+ (_control_stream ? _control_stream->memory_bytes() : 0)
+		+ sizeof(ObjectPools)
+		+ Symbol::table_bytes(); // Shared by all canvases
+	canvas.gobject_bytes = gobject_bytes(gobj())
+		+ group_gobject_bytes(*root())
+		+ item_gobject_bytes(&_base_rect)
+		+ item_gobject_bytes(_select_rect);
+	for (unsigned i = 0; i < N_LAYERS; ++i)
+		canvas.gobject_bytes += group_gobject_bytes(*_layers[i]);
+
+	return report;
+}
+
+
+void
+Canvas::record_operation(Operation op, uint64_t start_us, uint64_t dur_us)
+{
+	_stats[op].add(dur_us);
+	if (_tracing)
+		_trace->record(op, start_us, dur_us);
+}
+
+
+/** Start or stop recording a timeline of canvas operations.
+ *
+ * Starting discards any previous trace.  Stopping keeps it, so it can still
+ * be written with dump_trace().  Only has an effect if FlowCanvas was
+ * configured with --instrument.
+ */
+void
+Canvas::set_tracing(bool enable)
+{
+	if (enable) {
+		delete _trace;
+		_trace = new TraceBuffer();
+	}
+	_tracing = enable;
+}
+
+
+/** Write the recorded timeline as Chrome trace event JSON.
+ *
+ * This contains the most recent (up to 65536) operations recorded between
+ * the last set_tracing(true) and set_tracing(false) (or now), and can be
+ * viewed in chrome://tracing or Perfetto.
+ */
+bool
+Canvas::dump_trace(const string& filename) const
+{
+	if (!_trace) {
+		cerr << "Never traced, unable to write " << filename << endl;
+		return false;
+	}
+
+	return _trace->write_chrome_json(filename);
+}
+
+
 void
 Canvas::clear_selection()
 {
+	FLOWCANVAS_INSTRUMENT_SCOPE(this, OP_CLEAR_SELECTION);
+
 	unselect_ports();
 
 	for (list<boost::shared_ptr<Item> >::iterator m = _selected_items.begin(); m != _selected_items.end(); ++m)
@@ -194,6 +357,9 @@ Canvas::clear_selection()
 
 	_selected_items.clear();
 	_selected_connections.clear();
+
+	_model.clear_selection();
+	update_select_animation();
 }
 
 
@@ -208,6 +374,9 @@ Canvas::unselect_connection(Connection* connection)
 		}
 	}
 
+	if (connection->_model_id != GraphModel::NONE)
+		_model.set_edge_selected(connection->_model_id, false);
+
 	connection->set_selected(false);
 }
 
@@ -217,35 +386,18 @@ Canvas::unselect_connection(Connection* connection)
 void
 Canvas::select_item(boost::shared_ptr<Item> m)
 {
+	FLOWCANVAS_INSTRUMENT_SCOPE(this, OP_SELECT_ITEM);
+
 	assert(! m->selected());
 
 	_selected_items.push_back(m);
 
-	for (ConnectionList::iterator i = _connections.begin(); i != _connections.end(); ++i) {
-		const boost::shared_ptr<Connection>  c = (*i);
-		const boost::shared_ptr<Connectable> src = c->source().lock();
-		const boost::shared_ptr<Connectable> dst = c->dest().lock();
-		if (!src || !dst)
-			continue;
-
-		const boost::shared_ptr<Port> src_port
-			= boost::dynamic_pointer_cast<Port>(src);
-		const boost::shared_ptr<Port> dst_port
-			= boost::dynamic_pointer_cast<Port>(dst);
-
-		if (!src_port || !dst_port)
-			continue;
-
-		const boost::shared_ptr<Module> src_module = src_port->module().lock();
-		const boost::shared_ptr<Module> dst_module = dst_port->module().lock();
-		if (!src_module || !dst_module)
-			continue;
-
-		if ( !c->selected()) {
-			if (src_module == m && dst_module->selected()) {
-				c->set_selected(true);
-				_selected_connections.push_back(c);
-			} else if (dst_module == m && src_module->selected()) {
+	if (m->_model_id != GraphModel::NONE) {
+		std::vector<GraphModel::EdgeID> edges;
+		_model.select_item(m->_model_id, edges);
+		for (std::vector<GraphModel::EdgeID>::const_iterator e = edges.begin(); e != edges.end(); ++e) {
+			const boost::shared_ptr<Connection> c = _edge_views[*e].lock();
+			if (c && !c->selected()) {
 				c->set_selected(true);
 				_selected_connections.push_back(c);
 			}
@@ -253,39 +405,24 @@ Canvas::select_item(boost::shared_ptr<Item> m)
 	}
 
 	m->set_selected(true);
+	update_select_animation();
 }
 
 
 void
 Canvas::unselect_item(boost::shared_ptr<Item> m)
 {
-	// Remove any connections that aren't selected anymore because this module isn't
-	boost::shared_ptr<Connection> c;
-	for (ConnectionList::iterator i = _selected_connections.begin(); i != _selected_connections.end() ; ) {
-		c = (*i);
-
-		if (boost::dynamic_pointer_cast<Item>(c->source().lock()) == m
-				|| boost::dynamic_pointer_cast<Item>(c->dest().lock()) == m) {
-			c->set_selected(false);
-			i = _selected_connections.erase(i);
-			continue;
-		}
-
-		boost::shared_ptr<Port> src_port = boost::dynamic_pointer_cast<Port>(c->source().lock());
-		if (src_port && src_port->module().lock() == m) {
-			c->set_selected(false);
-			i = _selected_connections.erase(i);
-			continue;
-		}
+	FLOWCANVAS_INSTRUMENT_SCOPE(this, OP_UNSELECT_ITEM);
 
-		boost::shared_ptr<Port> dst_port = boost::dynamic_pointer_cast<Port>(c->dest().lock());
-		if (dst_port && dst_port->module().lock() == m) {
-			c->set_selected(false);
-			i = _selected_connections.erase(i);
-			continue;
+	// Remove any connections that aren't selected anymore because this module isn't
+	if (m->_model_id != GraphModel::NONE) {
+		std::vector<GraphModel::EdgeID> edges;
+		_model.unselect_item(m->_model_id, edges);
+		for (std::vector<GraphModel::EdgeID>::const_iterator e = edges.begin(); e != edges.end(); ++e) {
+			const boost::shared_ptr<Connection> c = _edge_views[*e].lock();
+			if (c)
+				unselect_connection(c.get());
 		}
-
-		++i;
 	}
 
 	// Remove the module
@@ -297,10 +434,81 @@ Canvas::unselect_item(boost::shared_ptr<Item> m)
 	}
 
 	m->set_selected(false);
+	update_select_animation();
+}
+
+
+typedef std::pair<GnomeCanvasItem*, boost::shared_ptr<Gnome::Canvas::Group> > DoomedObject;
+typedef std::vector<DoomedObject>                                                 DoomedObjects;
+
+struct DoomedObjectLess {
+	bool operator()(const DoomedObject& a, const DoomedObject& b) const { return a.first < b.first; }
+	bool operator()(const DoomedObject& a, GnomeCanvasItem* b)    const { return a.first < b; }
+};
+
+
+/** Clear the visible flag of @a item and everything in it.
+ *
+ * Destroying a visible item requests a redraw of its area, which is wasted
+ * work when everything on the canvas is going away.
+ */
+static void
+unset_visible(GnomeCanvasItem* item)
+{
+	GTK_OBJECT_UNSET_FLAGS(item, GNOME_CANVAS_ITEM_VISIBLE);
+	if (GNOME_IS_CANVAS_GROUP(item))
+		for (GList* l = GNOME_CANVAS_GROUP(item)->item_list; l; l = l->next)
+			unset_visible(GNOME_CANVAS_ITEM(l->data));
+}
+
+
+/** Add @a object to @a doomed if the reference given is the only one. */
+template<typename T>
+static void
+doom(DoomedObjects& doomed, const boost::shared_ptr<T>& object)
+{
+	if (object.unique()) {
+		GnomeCanvasItem* const item = GNOME_CANVAS_ITEM(object->gobj());
+		unset_visible(item);
+		doomed.push_back(DoomedObject(item, object));
+	}
+}
+
+
+/** Destroy @a doomed, children of each of @a groups in the order it lists them.
+ *
+ * A group finds a child to unlink by scanning its list from the start, so
+ * destroying children front to back makes each unlink constant time.
+ */
+static void
+destroy_in_stacking_order(Gnome::Canvas::Group* const* groups, unsigned n_groups,
+                          DoomedObjects& doomed)
+{
+	std::sort(doomed.begin(), doomed.end(), DoomedObjectLess());
+
+	std::vector<size_t> order;
+	order.reserve(doomed.size());
+	for (unsigned g = 0; g < n_groups; ++g) {
+		for (GList* l = groups[g]->gobj()->item_list; l; l = l->next) {
+			GnomeCanvasItem* const item = GNOME_CANVAS_ITEM(l->data);
+			DoomedObjects::iterator d = std::lower_bound(
+				doomed.begin(), doomed.end(), item, DoomedObjectLess());
+			if (d != doomed.end() && d->first == item)
+				order.push_back(d - doomed.begin());
+		}
+	}
+
+	for (std::vector<size_t>::const_iterator i = order.begin(); i != order.end(); ++i)
+		doomed[*i].second.reset();
+
+	doomed.clear();
 }
 
 
 /** Removes all ports and connections and modules.
+ *
+ * Objects only the canvas refers to are destroyed in bulk without
+ * requesting redraws, and the canvas is redrawn once afterwards.
  */
 void
 Canvas::destroy()
@@ -310,13 +518,46 @@ Canvas::destroy()
 	_selected_items.clear();
 	_selected_connections.clear();
 
+	DoomedObjects doomed;
+	doomed.reserve(_connections.size() + _items.size());
+
+	for (ConnectionList::iterator c = _connections.begin(); c != _connections.end(); ++c) {
+		(*c)->_model_id = GraphModel::NONE;
+		doom(doomed, *c);
+	}
+
 	_connections.clear();
 
 	_selected_ports.clear();
 	_connect_port.reset();
 
+	_transition_from.clear();
+	_transition_to.clear();
+
+	for (ItemList::iterator i = _items.begin(); i != _items.end(); ++i) {
+		(*i)->_model_id = GraphModel::NONE;
+		const boost::shared_ptr<Module> module = boost::dynamic_pointer_cast<Module>(*i);
+		if (module)
+			for (PortVector::iterator p = module->ports().begin(); p != module->ports().end(); ++p)
+				(*p)->_model_id = GraphModel::NONE;
+		doom(doomed, *i);
+	}
+
 	_items.clear();
 
+	if (!doomed.empty()) {
+		destroy_in_stacking_order(_layers, N_LAYERS, doomed);
+		queue_draw();
+	}
+
+	_model.clear();
+	_item_views.clear();
+	_port_views.clear();
+	_edge_views.clear();
+
+	// Start new pools, the old ones are freed in bulk with the last object
+	_pools.reset(new ObjectPools());
+
 	_remove_objects = true;
 }
 
@@ -419,8 +660,68 @@ Canvas::set_default_placement(boost::shared_ptr<Module> m)
 void
 Canvas::add_item(boost::shared_ptr<Item> m)
 {
-	if (m)
+	FLOWCANVAS_INSTRUMENT_SCOPE(this, OP_ADD_ITEM);
+
+	if (m && m->_model_id == GraphModel::NONE) {
 		_items.push_back(m);
+
+		const boost::shared_ptr<Module> module = boost::dynamic_pointer_cast<Module>(m);
+
+		m->_model_id = _model.add_item(module ? GraphModel::MODULE : GraphModel::ITEM,
+			m->symbol(), m->property_x(), m->property_y(), m->width(), m->height());
+		if (m->_model_id >= _item_views.size())
+			_item_views.resize(m->_model_id + 1);
+		_item_views[m->_model_id] = m;
+
+		if (module)
+			for (PortVector::iterator p = module->ports().begin(); p != module->ports().end(); ++p)
+				add_port_to_model(*p);
+	}
+}
+
+
+/** Add a port to the model, if its module is on this canvas. */
+void
+Canvas::add_port_to_model(boost::shared_ptr<Port> p)
+{
+	const boost::shared_ptr<Module> m = p->module().lock();
+	if (!m || m->_model_id == GraphModel::NONE || p->_model_id != GraphModel::NONE)
+		return;
+
+	p->_model_id = _model.add_port(m->_model_id, p->symbol(), p->is_input());
+	_model.set_port_geometry(p->_model_id,
+		p->property_x(), p->property_y(), p->width(), p->height());
+	if (p->_model_id >= _port_views.size())
+		_port_views.resize(p->_model_id + 1);
+	_port_views[p->_model_id] = p;
+}
+
+
+/** Remove a port, and any connections to or from it, from the canvas model.
+ *
+ * The connections are removed from the canvas too, since a connection to
+ * a port that is not on the canvas could never be found or removed again.
+ */
+void
+Canvas::remove_port_from_model(Port& p)
+{
+	if (p._model_id == GraphModel::NONE)
+		return;
+
+	remove_port_connections(p);
+
+	std::vector<GraphModel::EdgeID> edges;
+	_model.port_edges(p._model_id, edges);
+	for (std::vector<GraphModel::EdgeID>::const_iterator e = edges.begin(); e != edges.end(); ++e) {
+		const boost::shared_ptr<Connection> c = _edge_views[*e].lock();
+		if (c)
+			c->_model_id = GraphModel::NONE;
+		_edge_views[*e].reset();
+	}
+
+	_model.remove_port(p._model_id);
+	_port_views[p._model_id].reset();
+	p._model_id = GraphModel::NONE;
 }
 
 
@@ -430,55 +731,104 @@ Canvas::add_item(boost::shared_ptr<Item> m)
 bool
 Canvas::remove_item(boost::shared_ptr<Item> item)
 {
-	bool ret = false;
+	FLOWCANVAS_INSTRUMENT_SCOPE(this, OP_REMOVE_ITEM);
 
-	// Remove from selection
-	for (list<boost::shared_ptr<Item> >::iterator i = _selected_items.begin(); i != _selected_items.end(); ++i) {
-		if ((*i) == item) {
-			_selected_items.erase(i);
-			break;
+	const bool ret = find(_items.begin(), _items.end(), item) != _items.end();
+	remove_items(ItemList(1, item));
+	return ret;
+}
+
+
+/** Predicate for list::remove_if() that matches objects in a set. */
+template<typename T>
+struct InSet {
+	explicit InSet(const std::set<const T*>& s) : set(s) {}
+	bool operator()(const boost::shared_ptr<T>& p) const { return set.count(p.get()); }
+	const std::set<const T*>& set;
+};
+
+
+/** Remove @a items from the canvas, with one pass over each list.
+ *
+ * Connections of all items are removed together first, so removing many
+ * items takes time linear in the number of items and connections.
+ */
+void
+Canvas::remove_items(const ItemList& items)
+{
+	std::set<const Item*> doomed;
+	ConnectionList        adjacent;
+	bool                  selected = false;
+	for (ItemList::const_iterator i = items.begin(); i != items.end(); ++i) {
+		if (!doomed.insert(i->get()).second)
+			continue;
+
+		selected = selected || (*i)->selected();
+		if ((*i)->_model_id == GraphModel::NONE)
+			continue;
+
+		const std::vector<GraphModel::EdgeID>& edges = _model.item_edges((*i)->_model_id);
+		for (std::vector<GraphModel::EdgeID>::const_iterator e = edges.begin(); e != edges.end(); ++e) {
+			const boost::shared_ptr<Connection> c = _edge_views[*e].lock();
+			if (c)
+				adjacent.push_back(c);
 		}
 	}
 
+	// Remove any connections adjacent to these items
+	remove_connections(adjacent);
+
+	for (ItemList::const_iterator i = items.begin(); i != items.end(); ++i)
+		unlink_item(*i);
+
+	if (selected)
+		_selected_items.remove_if(InSet<Item>(doomed));
+
+	_items.remove_if(InSet<Item>(doomed));
+}
+
+
+/** Cut all references to @a item except from the item lists. */
+void
+Canvas::unlink_item(boost::shared_ptr<Item> item)
+{
 	// Remove children ports from selection if item is a module
 	boost::shared_ptr<Module> module = boost::dynamic_pointer_cast<Module>(item);
 	if (module) {
 		for (PortVector::iterator i = module->ports().begin(); i != module->ports().end(); ++i) {
-			unselect_port(*i);
-		}
-	}
-
-	// Remove from items
-	for (ItemList::iterator i = _items.begin(); i != _items.end(); ++i) {
-		if (*i == item) {
-			ret = true;
-			_items.erase(i);
-			break;
+			if ((*i)->selected())
+				unselect_port(*i);
 		}
 	}
 
-	// Remove any connections adjacent to this item
-	boost::shared_ptr<Connection> c;
-	for (ConnectionList::iterator i = _connections.begin(); i != _connections.end() ; ) {
-		c = (*i);
-		ConnectionList::iterator next = i;
-		++next;
+	// Stop animating it
+	_transition_from.erase(item);
+	_transition_to.erase(item);
 
-		const boost::shared_ptr<Port> src_port
-			= boost::dynamic_pointer_cast<Port>(c->source().lock());
-		const boost::shared_ptr<Port> dst_port
-			= boost::dynamic_pointer_cast<Port>(c->dest().lock());
+	if (item->_model_id == GraphModel::NONE)
+		return;
 
-		if (boost::dynamic_pointer_cast<Item>(c->source().lock()) == item
-				|| boost::dynamic_pointer_cast<Item>(c->dest().lock()) == item
-				|| (src_port && src_port->module().lock() == item)
-				|| (dst_port && dst_port->module().lock() == item))
-			remove_connection(c);
+	if (module) {
+		for (PortVector::iterator p = module->ports().begin(); p != module->ports().end(); ++p) {
+			if ((*p)->_model_id != GraphModel::NONE) {
+				_port_views[(*p)->_model_id].reset();
+				(*p)->_model_id = GraphModel::NONE;
+			}
+		}
+	}
 
-		i = next;
+	// Removes any remaining ports and edges as well
+	const std::vector<GraphModel::EdgeID>& remaining = _model.item_edges(item->_model_id);
+	for (std::vector<GraphModel::EdgeID>::const_iterator e = remaining.begin(); e != remaining.end(); ++e) {
+		const boost::shared_ptr<Connection> c = _edge_views[*e].lock();
+		if (c)
+			c->_model_id = GraphModel::NONE;
+		_edge_views[*e].reset();
 	}
 
-	return ret;
+	_model.remove_item(item->_model_id);
+	_item_views[item->_model_id].reset();
+	item->_model_id = GraphModel::NONE;
 }
 
 
@@ -505,112 +855,840 @@ Canvas::remove_connection(boost::shared_ptr<Connectable> item1,
 }
 
 
-/** Return whether there is a connection between item1 and item2.
+/** Make the objects created by sync() match @a graph.
  *
- * Note that connections are directed, so this may return false when there
- * is a connection between the two items (in the opposite direction).
+ * Modules, ports and connections are identified by the IDs in @a graph.
+ * Those not there before are created with create_module() and create_port(),
+ * those no longer there are removed, and those whose name changed are
+ * renamed.  A port whose direction or color changed is replaced by a new
+ * one, and a connection whose color changed is recolored.  Everything else,
+ * including positions and selection, is left as it is.  Objects not created
+ * by sync() are never touched.  Repeated IDs are ignored (with a warning)
+ * after the first.  The description is taken to be the real state of the
+ * graph, so connect() and disconnect() are not called.
  */
-bool
-Canvas::are_connected(boost::shared_ptr<const Connectable> tail,
-                      boost::shared_ptr<const Connectable> head)
+void
+Canvas::sync(const GraphDescription& graph)
 {
-	for (ConnectionList::const_iterator c = _connections.begin(); c != _connections.end(); ++c) {
-		const boost::shared_ptr<Connectable> src = (*c)->source().lock();
-		const boost::shared_ptr<Connectable> dst = (*c)->dest().lock();
+	FLOWCANVAS_INSTRUMENT_SCOPE(this, OP_SYNC);
 
-		if (src == tail && dst == head)
-			return true;
-	}
+	if (!_sync_index)
+		_sync_index = new SyncIndex();
 
-	return false;
-}
+	SyncIndex::Modules& index = _sync_index->modules;
+	SyncIndex::Modules  synced;
 
+	for (vector<ModuleDescription>::const_iterator md = graph.modules.begin();
+			md != graph.modules.end(); ++md) {
+		if (synced.count(md->id)) {
+			cerr << "Warning: sync: duplicate module '" << md->id << "'" << endl;
+			continue;
+		}
 
-/** Get the connection between two items.
- *
- * Note that connections are directed.
- * This will only return a connection from @a tail to @a head.
- */
-boost::shared_ptr<Connection>
-Canvas::get_connection(boost::shared_ptr<Connectable> tail,
-                           boost::shared_ptr<Connectable> head) const
-{
-	for (ConnectionList::const_iterator i = _connections.begin(); i != _connections.end(); ++i) {
-		const boost::shared_ptr<Connectable> src = (*i)->source().lock();
-		const boost::shared_ptr<Connectable> dst = (*i)->dest().lock();
+		boost::shared_ptr<Module> module;
+		SyncIndex::Ports          old_ports;
 
-		if (src == tail && dst == head)
-			return *i;
-	}
+		SyncIndex::Modules::iterator old = index.find(md->id);
+		if (old != index.end()) {
+			module = old->second.module.lock();
+			old_ports.swap(old->second.ports);
+			index.erase(old);
+		}
 
-	return boost::shared_ptr<Connection>();
-}
+		bool resize = false;
+		if (!module) {
+			module = create_module(*md);
+			add_item(module);
+			resize = true;
+		} else if (module->name() != md->name) {
+			module->set_name(md->name);
+		}
 
+		SyncIndex::SyncedModule& s = synced[md->id];
+		s.module = module;
 
-bool
-Canvas::add_connection(boost::shared_ptr<Connectable> src,
-                       boost::shared_ptr<Connectable> dst,
-                       uint32_t                       color)
-{
-	// Create (graphical) connection object
-	boost::shared_ptr<Connection> c(new Connection(shared_from_this(), src, dst, color));
-	src->add_connection(c);
-	dst->add_connection(c);
-	_connections.push_back(c);
+		PortVector removed;
+		for (vector<PortDescription>::const_iterator pd = md->ports.begin();
+				pd != md->ports.end(); ++pd) {
+			if (s.ports.count(pd->id)) {
+				cerr << "Warning: sync: duplicate port '" << md->id << ":" << pd->id << "'" << endl;
+				continue;
+			}
 
-	return true;
-}
+			boost::shared_ptr<Port> port;
 
+			SyncIndex::Ports::iterator old_port = old_ports.find(pd->id);
+			if (old_port != old_ports.end()) {
+				port = old_port->second.lock();
+				old_ports.erase(old_port);
+			}
 
-bool
-Canvas::add_connection(boost::shared_ptr<Connection> c)
-{
-	const boost::shared_ptr<Connectable> src = c->source().lock();
-	const boost::shared_ptr<Connectable> dst = c->dest().lock();
+			// Direction and color are fixed when a port is created
+			if (port && (port->is_input() != pd->is_input || port->color() != pd->color)) {
+				removed.push_back(port);
+				port.reset();
+			}
 
-	if (src && dst) {
-		src->add_connection(c);
-		dst->add_connection(c);
-		_connections.push_back(c);
-		return true;
-	} else {
-		return false;
-	}
-}
+			if (!port) {
+				port = create_port(module, *pd);
+				module->add_port(port);
+				resize = true;
+			} else if (port->name() != pd->name) {
+				port->set_name(pd->name);
+				resize = true;
+			}
 
+			s.ports[pd->id] = port;
+		}
 
-void
-Canvas::remove_connection(boost::shared_ptr<Connection> connection)
-{
-	if (!_remove_objects)
-		return;
+		// Remove ports that are gone (and their connections)
+		for (SyncIndex::Ports::iterator p = old_ports.begin(); p != old_ports.end(); ++p) {
+			const boost::shared_ptr<Port> port = p->second.lock();
+			if (port)
+				removed.push_back(port);
+		}
+
+		if (!removed.empty())
+			module->remove_ports(removed); // Resizes
+		else if (resize)
+			module->resize();
+	}
+
+	// Remove modules that are gone (and their connections)
+	ItemList gone;
+	for (SyncIndex::Modules::iterator m = index.begin(); m != index.end(); ++m) {
+		const boost::shared_ptr<Module> module = m->second.module.lock();
+		if (module)
+			gone.push_back(module);
+	}
+	remove_items(gone);
+
+	index.swap(synced);
+
+	// Connections wanted between synced ports, by (tail, head)
+	typedef std::pair<const Connectable*, const Connectable*> Edge;
+	typedef std::pair<ConnectablePair, uint32_t>              NewConnection;
+	typedef std::map<Edge, NewConnection>                     Edges;
+
+	Edges wanted;
+	for (vector<ConnectionDescription>::const_iterator cd = graph.connections.begin();
+			cd != graph.connections.end(); ++cd) {
+		const boost::shared_ptr<Port> tail = find_synced_port(cd->tail_module, cd->tail_port);
+		const boost::shared_ptr<Port> head = find_synced_port(cd->head_module, cd->head_port);
+		if (!tail || !head) {
+			cerr << "Warning: sync: no port for connection " << cd->tail_module << ":"
+				<< cd->tail_port << " -> " << cd->head_module << ":" << cd->head_port << endl;
+			continue;
+		}
+
+		wanted.insert(std::make_pair(Edge(tail.get(), head.get()),
+			NewConnection(ConnectablePair(tail, head), cd->color)));
+	}
+
+	std::set<const Connectable*> synced_ports;
+	for (SyncIndex::Modules::const_iterator m = index.begin(); m != index.end(); ++m)
+		for (SyncIndex::Ports::const_iterator p = m->second.ports.begin(); p != m->second.ports.end(); ++p)
+			if (!p->second.expired())
+				synced_ports.insert(p->second.lock().get());
+
+	// Remove unwanted connections, leaving those still to be made in wanted
+	ConnectionList unwanted;
+	for (ConnectionList::const_iterator c = _connections.begin(); c != _connections.end(); ++c) {
+		const Edge edge((*c)->_ends[0], (*c)->_ends[1]);
+		if (!synced_ports.count(edge.first) || !synced_ports.count(edge.second))
+			continue;
+
+		Edges::iterator w = wanted.find(edge);
+		if (w != wanted.end()) {
+			if ((*c)->_color != w->second.second)
+				(*c)->set_color(w->second.second);
+			wanted.erase(w);
+		} else {
+			unwanted.push_back(*c);
+		}
+	}
+
+	remove_connections(unwanted);
+
+	for (Edges::const_iterator w = wanted.begin(); w != wanted.end(); ++w)
+		add_connection(w->second.first.first, w->second.first.second, w->second.second);
+}
+
+
+/** Return the port created by sync() with the given IDs, or null. */
+boost::shared_ptr<Port>
+Canvas::find_synced_port(const std::string& module_id, const std::string& port_id) const
+{
+	if (!_sync_index)
+		return boost::shared_ptr<Port>();
+
+	const SyncIndex::Modules&          modules = _sync_index->modules;
+	SyncIndex::Modules::const_iterator m       = modules.find(module_id);
+	if (m == modules.end())
+		return boost::shared_ptr<Port>();
+
+	SyncIndex::Ports::const_iterator p = m->second.ports.find(port_id);
+	return (p != m->second.ports.end()) ? p->second.lock() : boost::shared_ptr<Port>();
+}
+
+
+/** Remove all connections to or from @a port from the canvas. */
+void
+Canvas::remove_port_connections(Port& port)
+{
+	ConnectionList doomed;
+	const Connectable::Connections& connections = port.connections();
+	for (Connectable::Connections::const_iterator i = connections.begin(); i != connections.end(); ++i) {
+		const boost::shared_ptr<Connection> c = i->lock();
+		if (c)
+			doomed.push_back(c);
+	}
+
+	remove_connections(doomed);
+}
+
+
+boost::shared_ptr<Module>
+Canvas::create_module(const ModuleDescription& desc)
+{
+	return boost::allocate_shared<Module>(
+		allocator<Module>(), shared_from_this(), desc.name, desc.x, desc.y);
+}
+
+
+boost::shared_ptr<Port>
+Canvas::create_port(boost::shared_ptr<Module> module, const PortDescription& desc)
+{
+	return boost::allocate_shared<Port>(
+		allocator<Port>(), module, desc.name, desc.is_input, desc.color);
+}
+
+
+void
+Canvas::enable_command_queue(unsigned order)
+{
+	if (_commands)
+		return;
+
+	_commands = new CommandQueue(order);
+	poll_commands(FRAME_INTERVAL_MS);
+}
+
+
+/** Check for posted commands every @a interval_ms (GUI thread).
+ *
+ * Posting threads never wake the GUI thread (which would need a system
+ * call), so the queue is always polled, just less often when idle.
+ */
+void
+Canvas::poll_commands(unsigned interval_ms)
+{
+	_command_connection.disconnect();
+	_command_connection = Glib::signal_timeout().connect(
+		sigc::mem_fun(this, &Canvas::apply_commands), interval_ms,
+		Glib::PRIORITY_DEFAULT_IDLE);
+}
+
+
+bool
+Canvas::post(const GraphCommand& command)
+{
+	return _commands && _commands->push(command);
+}
+
+
+bool
+Canvas::post_add_module(const char* id, const char* name, double x, double y)
+{
+	GraphCommand c(GraphCommand::ADD_MODULE);
+	c.x = x;
+	c.y = y;
+	return GraphCommand::set(c.module, id) && GraphCommand::set(c.name, name) && post(c);
+}
+
+
+bool
+Canvas::post_remove_module(const char* id)
+{
+	GraphCommand c(GraphCommand::REMOVE_MODULE);
+	return GraphCommand::set(c.module, id) && post(c);
+}
+
+
+bool
+Canvas::post_add_port(const char* module_id, const char* port_id, const char* name,
+                      bool is_input, uint32_t color)
+{
+	GraphCommand c(GraphCommand::ADD_PORT);
+	c.is_input = is_input;
+	c.color    = color;
+	return GraphCommand::set(c.module, module_id) && GraphCommand::set(c.port, port_id)
+		&& GraphCommand::set(c.name, name) && post(c);
+}
+
+
+bool
+Canvas::post_remove_port(const char* module_id, const char* port_id)
+{
+	GraphCommand c(GraphCommand::REMOVE_PORT);
+	return GraphCommand::set(c.module, module_id) && GraphCommand::set(c.port, port_id)
+		&& post(c);
+}
+
+
+bool
+Canvas::post_connect(const char* tail_module_id, const char* tail_port_id,
+                     const char* head_module_id, const char* head_port_id,
+                     uint32_t color)
+{
+	GraphCommand c(GraphCommand::CONNECT);
+	c.color = color;
+	return GraphCommand::set(c.module, tail_module_id) && GraphCommand::set(c.port, tail_port_id)
+		&& GraphCommand::set(c.head_module, head_module_id)
+		&& GraphCommand::set(c.head_port, head_port_id)
+		&& post(c);
+}
+
+
+bool
+Canvas::post_disconnect(const char* tail_module_id, const char* tail_port_id,
+                        const char* head_module_id, const char* head_port_id)
+{
+	GraphCommand c(GraphCommand::DISCONNECT);
+	return GraphCommand::set(c.module, tail_module_id) && GraphCommand::set(c.port, tail_port_id)
+		&& GraphCommand::set(c.head_module, head_module_id)
+		&& GraphCommand::set(c.head_port, head_port_id)
+		&& post(c);
+}
+
+
+bool
+Canvas::post_rename_module(const char* id, const char* name)
+{
+	GraphCommand c(GraphCommand::RENAME_MODULE);
+	return GraphCommand::set(c.module, id) && GraphCommand::set(c.name, name) && post(c);
+}
+
+
+bool
+Canvas::post_rename_port(const char* module_id, const char* port_id, const char* name)
+{
+	GraphCommand c(GraphCommand::RENAME_PORT);
+	return GraphCommand::set(c.module, module_id) && GraphCommand::set(c.port, port_id)
+		&& GraphCommand::set(c.name, name) && post(c);
+}
+
+
+bool
+Canvas::post_set_control(const char* module_id, const char* port_id, float value)
+{
+	GraphCommand c(GraphCommand::SET_CONTROL);
+	c.value = value;
+	return GraphCommand::set(c.module, module_id) && GraphCommand::set(c.port, port_id)
+		&& post(c);
+}
+
+
+void
+Canvas::enable_control_stream(size_t max_ports)
+{
+	if (_control_stream)
+		return;
 
-	unselect_connection(connection.get());
+	_control_stream = new ControlStream(max_ports);
+}
+
+
+/** Show streamed control values every frame (GUI thread). */
+void
+Canvas::start_control_stream()
+{
+	_control_connection.disconnect();
+	_control_idle_frames = 0;
+	queue_frame();
+}
+
+
+/** Check for streamed values while no frames run (see apply_control_stream()).
+ *
+ * Streaming threads never wake the GUI thread (which would need a system
+ * call), so this polls slowly instead.
+ */
+bool
+Canvas::poll_control_stream()
+{
+	if (!_control_stream->written())
+		return true;
+
+	start_control_stream();
+	return false;
+}
+
+
+int
+Canvas::add_control_stream(boost::shared_ptr<Port> port)
+{
+	if (!_control_stream)
+		return -1;
+
+	const int handle = _control_stream->add(port);
+	if (handle >= 0)
+		start_control_stream();
+
+	return handle;
+}
+
+
+void
+Canvas::remove_control_stream(int handle)
+{
+	if (_control_stream)
+		_control_stream->remove(handle);
+}
+
+
+void
+Canvas::stream_control(int handle, float value)
+{
+	if (_control_stream)
+		_control_stream->write(handle, value);
+}
+
+
+/** Show the latest streamed control values (once per frame).
+ *
+ * Returns true while values are arriving, to keep frames coming.  After
+ * CONTROL_IDLE_FRAMES without new values, poll_control_stream() checks for
+ * them every IDLE_POLL_MS instead.  Values for ports that are off screen are
+ * kept until an expose (e.g. from scrolling or zooming) queues another frame.
+ */
+bool
+Canvas::apply_control_stream()
+{
+	if (!_control_stream || _control_stream->num_used() == 0)
+		return false;
+
+	// Visible area in world coordinates
+	int scroll_x, scroll_y;
+	get_scroll_offsets(scroll_x, scroll_y);
+	double x1, y1, x2, y2;
+	c2w(scroll_x, scroll_y, x1, y1);
+	c2w(scroll_x + get_allocation().get_width(), scroll_y + get_allocation().get_height(), x2, y2);
+
+	const double min_dx = 1.0 / _zoom; // One pixel
+
+	bool busy   = false;
+	bool hidden = false;
+
+	ControlStream::Slots& slots = _control_stream->slots();
+	for (ControlStream::Slots::iterator s = slots.begin(); s != slots.end(); ++s) {
+		if (!s->used)
+			continue;
+
+		const bool fresh = ControlStream::read(*s);
+		if (!fresh && !s->pending)
+			continue;
+
+		busy = busy || fresh;
+
+		const boost::shared_ptr<Port> port = s->port.lock();
+		if (!port) {
+			s->pending = false;
+			continue;
+		}
+
+		bool visible = true;
+		const GraphModel::PortID id = port->_model_id;
+		if (id != GraphModel::NONE) {
+			const GraphModel::ItemID item = _model.port_item(id);
+			const double px = _model.item_x(item) + _model.port_x(id);
+			const double py = _model.item_y(item) + _model.port_y(id);
+			visible = px < x2 && px + _model.port_w(id) > x1
+				&& py < y2 && py + _model.port_h(id) > y1;
+		}
+
+		s->pending = !port->stream_control(s->value, visible, min_dx);
+		hidden     = hidden || s->pending;
+	}
+
+	_control_hidden = hidden;
+
+	if (busy) {
+		_control_idle_frames = 0;
+		return true;
+	}
+
+	if (++_control_idle_frames < CONTROL_IDLE_FRAMES)
+		return true;
+
+	// Stop frames, and poll slowly until values arrive again
+	_control_idle_frames = 0;
+	_control_connection.disconnect();
+	_control_connection = Glib::signal_timeout().connect(
+		sigc::mem_fun(this, &Canvas::poll_control_stream), IDLE_POLL_MS,
+		Glib::PRIORITY_DEFAULT_IDLE);
+	return false;
+}
+
+
+/** Apply posted commands for up to COMMAND_BUDGET_US (run when idle).
+ *
+ * Commands left over when time runs out are applied on the next call, so a
+ * burst of notifications never stalls drawing or input for long.
+ */
+bool
+Canvas::apply_commands()
+{
+	_commands->take();
+
+	std::vector<GraphCommand>& pending = _commands->pending();
+	if (pending.empty()) {
+		// Poll slowly once nothing has been posted for a while
+		if (_command_idle_frames < COMMAND_IDLE_FRAMES
+				&& ++_command_idle_frames == COMMAND_IDLE_FRAMES) {
+			poll_commands(IDLE_POLL_MS);
+			return false;
+		}
+		return true;
+	}
+
+	if (_command_idle_frames == COMMAND_IDLE_FRAMES)
+		poll_commands(FRAME_INTERVAL_MS); // Commands arrived, poll every frame again
+
+	_command_idle_frames = 0;
+
+	FLOWCANVAS_INSTRUMENT_SCOPE(this, OP_COMMANDS);
+
+	_commands->coalesce();
+
+	std::set< boost::shared_ptr<Module> > dirty;
+	const uint64_t start = monotonic_us();
+	size_t         n     = 0;
+	while (n < pending.size()) {
+		apply_command(pending[n++], dirty);
+		if (monotonic_us() - start > COMMAND_BUDGET_US)
+			break;
+	}
+
+	pending.erase(pending.begin(), pending.begin() + n);
+
+	for (std::set< boost::shared_ptr<Module> >::const_iterator m = dirty.begin(); m != dirty.end(); ++m)
+		(*m)->resize();
+
+	return true;
+}
+
+
+/** Apply a single posted command, adding modules that need a resize to @a dirty. */
+void
+Canvas::apply_command(const GraphCommand& c, std::set< boost::shared_ptr<Module> >& dirty)
+{
+	if (!_sync_index)
+		_sync_index = new SyncIndex();
+
+	SyncIndex::Modules&          modules = _sync_index->modules;
+	SyncIndex::Modules::iterator m       = modules.find(c.module);
+	boost::shared_ptr<Module>    module  = (m != modules.end()) ? m->second.module.lock()
+	                                                            : boost::shared_ptr<Module>();
+
+	if (c.type == GraphCommand::ADD_MODULE) {
+		if (!module) {
+			module = create_module(ModuleDescription(c.module, c.name, c.x, c.y));
+			add_item(module);
+			modules[c.module].module = module;
+			dirty.insert(module);
+		}
+		return;
+	} else if (!module) {
+		cerr << "Warning: no module '" << c.module << "' for posted command" << endl;
+		return;
+	}
+
+	SyncIndex::Ports&          ports = m->second.ports;
+	SyncIndex::Ports::iterator p     = ports.find(c.port);
+	boost::shared_ptr<Port>    port  = (p != ports.end()) ? p->second.lock()
+	                                                      : boost::shared_ptr<Port>();
+
+	switch (c.type) {
+	case GraphCommand::REMOVE_MODULE:
+		dirty.erase(module);
+		remove_item(module);
+		modules.erase(m);
+		return;
+	case GraphCommand::ADD_PORT:
+		if (!port) {
+			port = create_port(module, PortDescription(c.port, c.name, c.is_input, c.color));
+			module->add_port(port);
+			ports[c.port] = port;
+			dirty.insert(module);
+		}
+		return;
+	case GraphCommand::RENAME_MODULE:
+		module->set_name(c.name);
+		return;
+	default:
+		break;
+	}
+
+	if (!port) {
+		cerr << "Warning: no port '" << c.module << ":" << c.port << "' for posted command" << endl;
+		return;
+	}
+
+	switch (c.type) {
+	case GraphCommand::REMOVE_PORT:
+		module->remove_port(port);
+		ports.erase(p);
+		break;
+	case GraphCommand::CONNECT:
+	case GraphCommand::DISCONNECT: {
+		const boost::shared_ptr<Port> head = find_synced_port(c.head_module, c.head_port);
+		if (!head) {
+			cerr << "Warning: no port '" << c.head_module << ":" << c.head_port
+				<< "' for posted command" << endl;
+		} else if (c.type == GraphCommand::CONNECT && !are_connected(port, head)) {
+			add_connection(port, head, c.color);
+		} else if (c.type == GraphCommand::DISCONNECT && are_connected(port, head)) {
+			remove_connection(port, head);
+		}
+		break;
+	}
+	case GraphCommand::RENAME_PORT:
+		port->set_name(c.name);
+		dirty.insert(module);
+		break;
+	case GraphCommand::SET_CONTROL:
+		port->set_control(c.value, false);
+		break;
+	default:
+		break;
+	}
+}
+
+
+/** Return whether there is a connection between item1 and item2.
+ *
+ * Note that connections are directed, so this may return false when there
+ * is a connection between the two items (in the opposite direction).
+ */
+bool
+Canvas::are_connected(boost::shared_ptr<const Connectable> tail,
+                      boost::shared_ptr<const Connectable> head)
+{
+	GraphModel::ItemID tail_item, head_item;
+	GraphModel::PortID tail_port, head_port;
+	if (model_endpoint(tail, tail_item, tail_port) && model_endpoint(head, head_item, head_port))
+		return _model.find_edge(tail_item, tail_port, head_item, head_port) != GraphModel::NONE;
+
+	// Not on this canvas, search every connection
+	for (ConnectionList::const_iterator c = _connections.begin(); c != _connections.end(); ++c) {
+		const boost::shared_ptr<Connectable> src = (*c)->source().lock();
+		const boost::shared_ptr<Connectable> dst = (*c)->dest().lock();
+
+		if (src == tail && dst == head)
+			return true;
+	}
+
+	return false;
+}
+
+
+/** Get the connection between two items.
+ *
+ * Note that connections are directed.
+ * This will only return a connection from @a tail to @a head.
+ */
+boost::shared_ptr<Connection>
+Canvas::get_connection(boost::shared_ptr<Connectable> tail,
+                           boost::shared_ptr<Connectable> head) const
+{
+	GraphModel::ItemID tail_item, head_item;
+	GraphModel::PortID tail_port, head_port;
+	if (model_endpoint(tail, tail_item, tail_port) && model_endpoint(head, head_item, head_port)) {
+		const GraphModel::EdgeID e = _model.find_edge(tail_item, tail_port, head_item, head_port);
+		return (e != GraphModel::NONE) ? _edge_views[e].lock() : boost::shared_ptr<Connection>();
+	}
+
+	// Not on this canvas, search every connection
+	for (ConnectionList::const_iterator i = _connections.begin(); i != _connections.end(); ++i) {
+		const boost::shared_ptr<Connectable> src = (*i)->source().lock();
+		const boost::shared_ptr<Connectable> dst = (*i)->dest().lock();
+
+		if (src == tail && dst == head)
+			return *i;
+	}
+
+	return boost::shared_ptr<Connection>();
+}
+
+
+bool
+Canvas::add_connection(boost::shared_ptr<Connectable> src,
+                       boost::shared_ptr<Connectable> dst,
+                       uint32_t                       color)
+{
+	FLOWCANVAS_INSTRUMENT_SCOPE(this, OP_ADD_CONNECTION);
+
+	// Create (graphical) connection object
+	boost::shared_ptr<Connection> c = boost::allocate_shared<Connection>(
+		allocator<Connection>(), shared_from_this(), src, dst, color);
+	src->add_connection(c);
+	dst->add_connection(c);
+	_connections.push_back(c);
+	add_connection_to_model(c);
+
+	return true;
+}
+
+
+bool
+Canvas::add_connection(boost::shared_ptr<Connection> c)
+{
+	FLOWCANVAS_INSTRUMENT_SCOPE(this, OP_ADD_CONNECTION);
+
+	const boost::shared_ptr<Connectable> src = c->source().lock();
+	const boost::shared_ptr<Connectable> dst = c->dest().lock();
+
+	if (src && dst) {
+		src->add_connection(c);
+		dst->add_connection(c);
+		_connections.push_back(c);
+		add_connection_to_model(c);
+		return true;
+	} else {
+		return false;
+	}
+}
+
+
+void
+Canvas::remove_connection(boost::shared_ptr<Connection> connection)
+{
+	FLOWCANVAS_INSTRUMENT_SCOPE(this, OP_REMOVE_CONNECTION);
+
+	if (!_remove_objects)
+		return;
+
+	if (connection->selected())
+		unselect_connection(connection.get());
 
 	ConnectionList::iterator i = find(_connections.begin(), _connections.end(), connection);
 
 	if (i != _connections.end()) {
-		const boost::shared_ptr<Connection> c = *i;
+		unlink_connection(*i);
+		_connections.erase(i);
+	}
+}
+
 
-		const boost::shared_ptr<Connectable> src = c->source().lock();
-		const boost::shared_ptr<Connectable> dst = c->dest().lock();
+/** Remove @a connections from the canvas, with one pass over each list. */
+void
+Canvas::remove_connections(const ConnectionList& connections)
+{
+	if (!_remove_objects || connections.empty())
+		return;
 
-		if (src)
-			src->remove_connection(c);
+	std::set<const Connection*> doomed;
+	bool                        selected = false;
+	for (ConnectionList::const_iterator c = connections.begin(); c != connections.end(); ++c) {
+		doomed.insert(c->get());
+		if ((*c)->selected()) {
+			(*c)->set_selected(false);
+			selected = true;
+		}
+	}
 
-		if (dst)
-			dst->remove_connection(c);
+	if (selected)
+		_selected_connections.remove_if(InSet<Connection>(doomed));
 
-		_connections.erase(i);
+	for (ConnectionList::iterator i = _connections.begin(); i != _connections.end();) {
+		if (doomed.count(i->get())) {
+			unlink_connection(*i);
+			i = _connections.erase(i);
+		} else {
+			++i;
+		}
 	}
 }
 
 
+/** Disconnect @a c from its ends and remove it from the model. */
+void
+Canvas::unlink_connection(boost::shared_ptr<Connection> c)
+{
+	const boost::shared_ptr<Connectable> src = c->source().lock();
+	const boost::shared_ptr<Connectable> dst = c->dest().lock();
+
+	if (src)
+		src->remove_connection(c);
+
+	if (dst)
+		dst->remove_connection(c);
+
+	if (c->_model_id != GraphModel::NONE) {
+		_model.remove_edge(c->_model_id);
+		_edge_views[c->_model_id].reset();
+		c->_model_id = GraphModel::NONE;
+	}
+}
+
+
+/** Add a connection to the model, if both ends are on this canvas. */
+void
+Canvas::add_connection_to_model(boost::shared_ptr<Connection> c)
+{
+	GraphModel::ItemID tail_item, head_item;
+	GraphModel::PortID tail_port, head_port;
+	if (c->_model_id != GraphModel::NONE
+			|| !model_endpoint(c->source().lock(), tail_item, tail_port)
+			|| !model_endpoint(c->dest().lock(), head_item, head_port))
+		return;
+
+	c->_model_id = _model.add_edge(tail_item, tail_port, head_item, head_port);
+	if (c->_model_id >= _edge_views.size())
+		_edge_views.resize(c->_model_id + 1);
+	_edge_views[c->_model_id] = c;
+}
+
+
+/** Get the model endpoint of a port or item.
+ *
+ * Returns false if @a c is not on this canvas.
+ */
+bool
+Canvas::model_endpoint(boost::shared_ptr<const Connectable> c,
+                       GraphModel::ItemID&                  item,
+                       GraphModel::PortID&                  port) const
+{
+	const Port* const p = dynamic_cast<const Port*>(c.get());
+	if (p) {
+		if (p->_model_id == GraphModel::NONE)
+			return false;
+		port = p->_model_id;
+		item = _model.port_item(port);
+		return true;
+	}
+
+	const Item* const i = dynamic_cast<const Item*>(c.get());
+	if (i && i->_model_id != GraphModel::NONE) {
+		port = GraphModel::NONE;
+		item = i->_model_id;
+		return true;
+	}
+
+	return false;
+}
+
+
 void
 Canvas::selection_joined_with(boost::shared_ptr<Port> port)
 {
+	ConnectablePairs to_connect;
+	ConnectablePairs to_disconnect;
 	for (SelectedPorts::iterator i = _selected_ports.begin(); i != _selected_ports.end(); ++i)
-		ports_joined(*i, port);
+		ports_joined(*i, port, to_connect, to_disconnect);
+
+	apply_joins(to_connect, to_disconnect);
 }
 
 
@@ -626,18 +1704,22 @@ Canvas::join_selection()
 			outputs.push_back(*i);
 	}
 
+	ConnectablePairs to_connect;
+	ConnectablePairs to_disconnect;
 	if (inputs.size() == 1) { // 1 -> n
 		for (size_t i = 0; i < outputs.size(); ++i)
-			ports_joined(inputs[0], outputs[i]);
+			ports_joined(inputs[0], outputs[i], to_connect, to_disconnect);
 	} else if (outputs.size() == 1) { // n -> 1
 		for (size_t i = 0; i < inputs.size(); ++i)
-			ports_joined(inputs[i], outputs[0]);
+			ports_joined(inputs[i], outputs[0], to_connect, to_disconnect);
 	} else { // n -> m
 		size_t num_to_connect = std::min(inputs.size(), outputs.size());
 		for (size_t i = 0; i < num_to_connect; ++i) {
-			ports_joined(inputs[i], outputs[i]);
+			ports_joined(inputs[i], outputs[i], to_connect, to_disconnect);
 		}
 	}
+
+	apply_joins(to_connect, to_disconnect);
 }
 
 
@@ -645,6 +1727,23 @@ Canvas::join_selection()
  */
 void
 Canvas::ports_joined(boost::shared_ptr<Port> port1, boost::shared_ptr<Port> port2)
+{
+	ConnectablePairs to_connect;
+	ConnectablePairs to_disconnect;
+	ports_joined(port1, port2, to_connect, to_disconnect);
+	apply_joins(to_connect, to_disconnect);
+}
+
+
+/** Add the connection or disconnection toggling two ports would make.
+ *
+ * Nothing is actually (dis)connected until apply_joins().
+ */
+void
+Canvas::ports_joined(boost::shared_ptr<Port> port1,
+                     boost::shared_ptr<Port> port2,
+                     ConnectablePairs&       to_connect,
+                     ConnectablePairs&       to_disconnect)
 {
 	if (port1 == port2)
 		return;
@@ -655,8 +1754,6 @@ Canvas::ports_joined(boost::shared_ptr<Port> port1, boost::shared_ptr<Port> port
 	port1->set_highlighted(false);
 	port2->set_highlighted(false);
 
-	string src_mod_name, dst_mod_name, src_port_name, dst_port_name;
-
 	boost::shared_ptr<Port> src_port;
 	boost::shared_ptr<Port> dst_port;
 
@@ -671,9 +1768,46 @@ Canvas::ports_joined(boost::shared_ptr<Port> port1, boost::shared_ptr<Port> port
 	}
 
 	if (are_connected(src_port, dst_port))
-		disconnect(src_port, dst_port);
+		to_disconnect.push_back(ConnectablePair(src_port, dst_port));
 	else
-		connect(src_port, dst_port);
+		to_connect.push_back(ConnectablePair(src_port, dst_port));
+}
+
+
+/** Make the connections collected by ports_joined().
+ *
+ * Single changes go to connect() or disconnect() as they always have, so
+ * applications that only implement those see no difference.
+ */
+void
+Canvas::apply_joins(const ConnectablePairs& to_connect,
+                    const ConnectablePairs& to_disconnect)
+{
+	if (to_disconnect.size() == 1)
+		disconnect(to_disconnect[0].first, to_disconnect[0].second);
+	else if (!to_disconnect.empty())
+		disconnect_many(to_disconnect);
+
+	if (to_connect.size() == 1)
+		connect(to_connect[0].first, to_connect[0].second);
+	else if (!to_connect.empty())
+		connect_many(to_connect);
+}
+
+
+void
+Canvas::connect_many(const ConnectablePairs& pairs)
+{
+	for (ConnectablePairs::const_iterator i = pairs.begin(); i != pairs.end(); ++i)
+		connect(i->first, i->second);
+}
+
+
+void
+Canvas::disconnect_many(const ConnectablePairs& pairs)
+{
+	for (ConnectablePairs::const_iterator i = pairs.begin(); i != pairs.end(); ++i)
+		disconnect(i->first, i->second);
 }
 
 
@@ -686,6 +1820,8 @@ Canvas::ports_joined(boost::shared_ptr<Port> port1, boost::shared_ptr<Port> port
 bool
 Canvas::port_event(GdkEvent* event, boost::weak_ptr<Port> weak_port)
 {
+	FLOWCANVAS_INSTRUMENT_SCOPE(this, OP_PORT_EVENT);
+
 	boost::shared_ptr<Port> port = weak_port.lock();
 	if (!port)
 		return false;
@@ -812,6 +1948,8 @@ Canvas::port_event(GdkEvent* event, boost::weak_ptr<Port> weak_port)
 bool
 Canvas::canvas_event(GdkEvent* event)
 {
+	FLOWCANVAS_INSTRUMENT_SCOPE(this, OP_CANVAS_EVENT);
+
 	static const int scroll_increment = 10;
 	int scroll_x, scroll_y;
 	get_scroll_offsets(scroll_x, scroll_y);
@@ -858,6 +1996,64 @@ Canvas::on_parent_changed(Gtk::Widget* old_parent)
 }
 
 
+void
+Canvas::on_hierarchy_changed(Gtk::Widget* previous_toplevel)
+{
+	_toplevel_event_connection.disconnect();
+
+	Gtk::Widget* const toplevel = get_toplevel();
+	if (toplevel && toplevel->is_toplevel()) {
+		Gtk::Window* const window = dynamic_cast<Gtk::Window*>(toplevel);
+		_focused = !window || window->is_active();
+		_toplevel_event_connection = toplevel->signal_event().connect(
+				sigc::mem_fun(*this, &Canvas::toplevel_event));
+	} else {
+		_focused = true;
+	}
+
+	update_select_animation();
+}
+
+
+/** Pause the selection animation while the window does not have focus. */
+bool
+Canvas::toplevel_event(GdkEvent* ev)
+{
+	if (ev->type == GDK_FOCUS_CHANGE) {
+		_focused = ev->focus_change.in;
+		update_select_animation();
+	}
+	return false;
+}
+
+
+bool
+Canvas::on_visibility_notify_event(GdkEventVisibility* event)
+{
+	_obscured = (event->state == GDK_VISIBILITY_FULLY_OBSCURED);
+	update_select_animation();
+	return Gnome::Canvas::CanvasAA::on_visibility_notify_event(event);
+}
+
+
+void
+Canvas::on_map()
+{
+	Gnome::Canvas::CanvasAA::on_map();
+	_obscured = false;
+	update_select_animation();
+}
+
+
+void
+Canvas::on_unmap()
+{
+	_obscured = true;
+	update_select_animation();
+	Gnome::Canvas::CanvasAA::on_unmap();
+}
+
+
 bool
 Canvas::frame_event(GdkEvent* ev)
 {
@@ -872,7 +2068,64 @@ Canvas::frame_event(GdkEvent* ev)
 			handled = true;
 		}
 	}
-	return handled;
+	return handled;
+}
+
+
+bool
+Canvas::on_expose_event(GdkEventExpose* event)
+{
+	FLOWCANVAS_INSTRUMENT_SCOPE(this, OP_REPAINT);
+
+	// Streamed values for ports that were off screen may be visible now
+	if (_control_hidden)
+		queue_frame();
+
+	if (!_hud)
+		return Gnome::Canvas::CanvasAA::on_expose_event(event);
+
+	const uint64_t start = Hud::now_us();
+	const bool     ret   = Gnome::Canvas::CanvasAA::on_expose_event(event);
+	_hud->frame_painted(event->area, start, Hud::now_us());
+	return ret;
+}
+
+
+bool
+Canvas::on_event(GdkEvent* event)
+{
+	if (_hud) {
+		switch (event->type) {
+		case GDK_MOTION_NOTIFY:
+		case GDK_BUTTON_PRESS:
+		case GDK_BUTTON_RELEASE:
+		case GDK_KEY_PRESS:
+		case GDK_KEY_RELEASE:
+		case GDK_SCROLL:
+			_hud->input_received();
+			break;
+		default:
+			break;
+		}
+	}
+
+	// Move to the final position of a drag before it ends
+	if (event->type == GDK_BUTTON_RELEASE || event->type == GDK_2BUTTON_PRESS)
+		flush_motion();
+
+	return Gnome::Canvas::CanvasAA::on_event(event);
+}
+
+
+void
+Canvas::set_show_hud(bool show)
+{
+	if (show && !_hud) {
+		_hud = new Hud(*this);
+	} else if (!show) {
+		delete _hud;
+		_hud = NULL;
+	}
 }
 
 
@@ -907,6 +2160,9 @@ Canvas::scroll_drag_handler(GdkEvent* event)
 		_drag_state = SCROLL;
 
 	} else if (event->type == GDK_MOTION_NOTIFY && _drag_state == SCROLL) {
+		if (defer_motion(event))
+			return true;
+
 		const double x        = event->motion.x_root;
 		const double y        = event->motion.y_root;
 		const double x_offset = last_x - x;
@@ -932,23 +2188,36 @@ Canvas::scroll_drag_handler(GdkEvent* event)
 }
 
 
+void
+Canvas::select_region(double x1, double y1, double x2, double y2)
+{
+	std::vector<GraphModel::ItemID> within;
+	_model.items_within(x1, y1, x2, y2, within);
+	for (std::vector<GraphModel::ItemID>::const_iterator i = within.begin(); i != within.end(); ++i) {
+		const boost::shared_ptr<Item> module = _item_views[*i].lock();
+		if (!module)
+			continue;
+		if (module->selected())
+			unselect_item(module);
+		else
+			select_item(module);
+	}
+}
+
+
 bool
 Canvas::select_drag_handler(GdkEvent* event)
 {
-	boost::shared_ptr<Item> module;
-
 	if (event->type == GDK_BUTTON_PRESS && event->button.button == 1) {
 		assert(_select_rect == NULL);
 		_drag_state = SELECT;
 		if ( !(event->button.state & (GDK_CONTROL_MASK | GDK_SHIFT_MASK)) )
 			clear_selection();
-		_select_rect = new Gnome::Canvas::Rect(*root(),
+		_select_rect = new Gnome::Canvas::Rect(*_layers[LAYER_BACKGROUND],
 			event->button.x, event->button.y, event->button.x, event->button.y);
 		_select_rect->property_fill_color_rgba() = 0x273344FF;
 		_select_rect->property_outline_color_rgba() = 0xEEEEFFFF;
 		_select_rect->property_width_units() = 0.5;
-		_select_rect->lower_to_bottom();
-		_base_rect.lower_to_bottom();
 		_base_rect.grab(GDK_POINTER_MOTION_MASK|GDK_BUTTON_RELEASE_MASK,
 				Gdk::Cursor(Gdk::ARROW), event->button.time);
 		return true;
@@ -968,16 +2237,8 @@ Canvas::select_drag_handler(GdkEvent* event)
 		_select_rect->property_y2() = y;
 		return true;
 	} else if (event->type == GDK_BUTTON_RELEASE && _drag_state == SELECT) {
-		// Select all modules within rect
-		for (ItemList::iterator i = _items.begin(); i != _items.end(); ++i) {
-			module = (*i);
-			if (module->is_within(*_select_rect)) {
-				if (module->selected())
-					unselect_item(module);
-				else
-					select_item(module);
-			}
-		}
+		select_region(_select_rect->property_x1(), _select_rect->property_y1(),
+		              _select_rect->property_x2(), _select_rect->property_y2());
 
 		_base_rect.ungrab(event->button.time);
 
@@ -992,10 +2253,15 @@ Canvas::select_drag_handler(GdkEvent* event)
 
 /** Updates _select_dash for rotation effect, and updates any
   * selected item's borders (and the selection rectangle).
+  *
+  * Stops itself once nothing is selected, see update_select_animation().
   */
 bool
 Canvas::animate_selected()
 {
+	if (_selected_items.empty() && _selected_connections.empty())
+		return false;
+
 	static int i = 0;
 
 	i = (i+1) % 10;
@@ -1014,23 +2280,43 @@ Canvas::animate_selected()
 }
 
 
+/** Run the selection animation only while something is selected and visible.
+ *
+ * Nothing wakes up the main loop for an empty selection, an unfocused
+ * window, or a canvas that is unmapped or fully obscured.
+ */
+void
+Canvas::update_select_animation()
+{
+	const bool run = _focused && !_obscured
+		&& !(_selected_items.empty() && _selected_connections.empty());
+
+	if (!run)
+		_select_animation.disconnect();
+	else if (!_select_animation.connected())
+		_select_animation = Glib::signal_timeout().connect(
+			sigc::mem_fun(this, &Canvas::animate_selected), SELECT_INTERVAL_MS);
+}
+
+
 bool
 Canvas::connection_drag_handler(GdkEvent* event)
 {
 	bool handled = true;
 
-	// These are invisible, just used for making connections (while dragging)
-	static boost::shared_ptr<Module> drag_module;
-	static boost::shared_ptr<Port>   drag_port;
+	// Free end of the connection being made, and the ports it may snap to
+	static boost::shared_ptr<DragAnchor> drag_anchor;
+	static SnapIndex                     snap_targets;
 
 	static boost::shared_ptr<Connection> drag_connection;
 	static boost::shared_ptr<Port>       snapped_port;
 
-	static bool snapped = false;
-
 	/*if (event->type == GDK_BUTTON_PRESS && event->button.button == 2) {
 		_drag_state = SCROLL;
 	} else */if (event->type == GDK_MOTION_NOTIFY && _drag_state == CONNECTION) {
+		if (defer_motion(event))
+			return true;
+
 		double x = event->button.x, y = event->button.y;
 
 		if (event->motion.is_hint) {
@@ -1044,127 +2330,53 @@ Canvas::connection_drag_handler(GdkEvent* event)
 		root()->w2i(x, y);
 
 		if (!drag_connection) { // Havn't created the connection yet
-			assert(drag_port == NULL);
+			assert(!drag_anchor);
 			assert(_connect_port);
 
-			drag_module = boost::shared_ptr<Module>(new Module(shared_from_this(), "", x, y));
-			bool drag_port_is_input = true;
-			if (_connect_port->is_input())
-				drag_port_is_input = false;
-
-			drag_port = boost::shared_ptr<Port>(new Port(drag_module, "", drag_port_is_input, _connect_port->color()));
-
-			//drag_port->hide();
-			drag_module->hide();
+			find_snap_targets(_connect_port, snap_targets);
 
-			drag_module->move_to(x, y);
+			drag_anchor = boost::shared_ptr<DragAnchor>(new DragAnchor(_direction == HORIZONTAL));
+			drag_anchor->move_to(x, y);
 
-			drag_port->property_x() = 0;
-			drag_port->property_y() = 0;
-			drag_port->_rect->property_x2() = 1;
-			drag_port->_rect->property_y2() = 1;
-
-			if (drag_port_is_input)
+			if (_connect_port->is_input())
 				drag_connection = boost::shared_ptr<Connection>(new Connection(
-					shared_from_this(), _connect_port, drag_port,
+					shared_from_this(), drag_anchor, _connect_port,
 					_connect_port->color() + 0x22222200));
 			else
 				drag_connection = boost::shared_ptr<Connection>(new Connection(
-					shared_from_this(), drag_port, _connect_port,
+					shared_from_this(), _connect_port, drag_anchor,
 					_connect_port->color() + 0x22222200));
 
-			drag_connection->update_location();
+			// Draw the wire being dragged above modules, not behind them
+			drag_connection->set_raised(true);
 		}
 
-		if (snapped) {
-			if (drag_connection)
-				drag_connection->hide();
-
-			boost::shared_ptr<Port> p = get_port_at(x, y);
-
-			if (drag_connection)
-				drag_connection->show();
-
-			if (p) {
-				boost::shared_ptr<Module> m = p->module().lock();
-				if (m) {
-					if (!p->selected()) {
-						if (snapped_port)
-							snapped_port->set_highlighted(false);
-						p->set_highlighted(true);
-						snapped_port = p;
-					}
-					drag_module->property_x() = m->property_x().get_value();
-					drag_module->_module_box.property_x2() = m->_module_box.property_x2().get_value();
-					drag_module->property_y() = m->property_y().get_value();
-					drag_module->_module_box.property_y2() = m->_module_box.property_y2().get_value();
-					drag_port->property_x() = p->property_x().get_value();
-					drag_port->property_y() = p->property_y().get_value();
-				}
-			} else {  // off the port now, unsnap
-				if (snapped_port)
-					snapped_port->set_highlighted(false);
-				snapped_port.reset();
-				snapped = false;
-				drag_module->property_x() = x;
-				drag_module->property_y() = y;
-				drag_port->property_x() = 0;
-				drag_port->property_y() = 0;
-				drag_port->_rect->property_x2() = 1;
-				drag_port->_rect->property_y2() = 1;
-			}
-			drag_connection->update_location();
-		} else { // not snapped to a port
-			assert(drag_module);
-			assert(drag_port);
-			assert(_connect_port);
-
-			// "Snap" to port, if we're on a port and it's the right direction
-			if (drag_connection)
-				drag_connection->hide();
-
-			boost::shared_ptr<Port> p = get_port_at(x, y);
-
-			if (drag_connection)
-				drag_connection->show();
-
-			if (p && p->is_input() != _connect_port->is_input()) {
-				boost::shared_ptr<Module> m = p->module().lock();
-				if (m) {
-					p->set_highlighted(true);
-					snapped_port = p;
-					snapped = true;
-					// Make drag module and port exactly the same size/loc as the snapped
-					drag_module->move_to(m->property_x().get_value(), m->property_y().get_value());
-					drag_module->set_width(m->width());
-					drag_module->set_height(m->height());
-					drag_port->property_x() = p->property_x().get_value();
-					drag_port->property_y() = p->property_y().get_value();
-					// Make the drag port as wide as the snapped port
-					// so the connection coords are the same
-					drag_port->_rect->property_x2() = p->_rect->property_x2().get_value();
-					drag_port->_rect->property_y2() = p->_rect->property_y2().get_value();
-				}
-			} else {
-				drag_module->property_x() = x;
-				drag_module->property_y() = y - 7; // FIXME: s#7#cursor_height/2#
-			}
-			drag_connection->update_location();
+		const boost::shared_ptr<Port> p = snap_targets.nearest(x, y, SNAP_DISTANCE_PX / _zoom);
+		if (p != snapped_port) {
+			if (snapped_port)
+				snapped_port->set_highlighted(false);
+			if (p && !p->selected())
+				p->set_highlighted(true);
+			snapped_port = p;
 		}
+
+		if (p)
+			drag_anchor->snap_to(p);
+		else
+			drag_anchor->move_to(x, y);
+
+		drag_connection->update_location();
 	} else if (event->type == GDK_BUTTON_RELEASE && _drag_state == CONNECTION) {
+		// Snap to where the pointer really is, not where the last frame had it
+		flush_motion();
+
 		_base_rect.ungrab(event->button.time);
 
 		double x = event->button.x;
 		double y = event->button.y;
 		_base_rect.i2w(x, y);
 
-		if (drag_connection)
-			drag_connection->hide();
-
-		boost::shared_ptr<Port> p = get_port_at(x, y);
-
-		if (drag_connection)
-			drag_connection->show();
+		boost::shared_ptr<Port> p = snapped_port ? snapped_port : get_port_at(x, y);
 
 		if (p) {
 			if (p == _connect_port) {  // drag ended on same port it started on
@@ -1192,8 +2404,8 @@ Canvas::connection_drag_handler(GdkEvent* event)
 
 		_drag_state = NOT_DRAGGING;
 		drag_connection.reset();
-		drag_module.reset();
-		drag_port.reset();
+		drag_anchor.reset();
+		snap_targets.clear();
 		unselect_ports();
 		snapped_port.reset();
 		_connect_port.reset();
@@ -1205,31 +2417,183 @@ Canvas::connection_drag_handler(GdkEvent* event)
 }
 
 
-boost::shared_ptr<Port>
-Canvas::get_port_at(double x, double y)
+/** Fill @a targets with the ports a connection dragged from @a port may snap to.
+ *
+ * Those are the ports of the opposite direction that can_snap_to() accepts.
+ */
+void
+Canvas::find_snap_targets(boost::shared_ptr<Port> port, SnapIndex& targets)
 {
-	// Loop through every port and see if the item at these coordinates is that port
-	// (if you're thinking this is slow, stupid, and disgusting, you're right)
-	for (ItemList::const_iterator i = _items.begin(); i != _items.end(); ++i) {
-		const boost::shared_ptr<Module> m
-			= boost::dynamic_pointer_cast<Module>(*i);
+	targets.clear();
+	for (GraphModel::ItemID i = 0; i < _model.item_capacity(); ++i) {
+		if (!_model.item_valid(i) || _model.item_kind(i) != GraphModel::MODULE)
+			continue;
+
+		const double item_x = _model.item_x(i);
+		const double item_y = _model.item_y(i);
+		const std::vector<GraphModel::PortID>& ports = _model.item_ports(i);
+		for (std::vector<GraphModel::PortID>::const_iterator p = ports.begin(); p != ports.end(); ++p) {
+			if (_model.port_is_input(*p) == port->is_input())
+				continue;
+
+			const boost::shared_ptr<Port> target = _port_views[*p].lock();
+			if (!target || !can_snap_to(port, target))
+				continue;
+
+			const double x = item_x + _model.port_x(*p);
+			const double y = item_y + _model.port_y(*p);
+			targets.add(target, x, y, x + _model.port_w(*p), y + _model.port_h(*p));
+		}
+	}
+}
+
+
+/** Defer the canvas drag motion @a event to the next frame.
+ *
+ * Only the latest pointer position of a drag matters, so however fast the
+ * pointer reports motion, a drag is updated at most once per frame.  Returns
+ * false if @a event is the deferred motion being handled by flush_motion(),
+ * in which case the caller handles it as usual.  Only the coordinates are
+ * kept, not the event.
+ */
+bool
+Canvas::defer_motion(GdkEvent* event)
+{
+	if (_motion.replaying)
+		return false;
+
+	double x = event->motion.x;
+	double y = event->motion.y;
+	if (event->motion.is_hint) {
+		gint            t_x;
+		gint            t_y;
+		GdkModifierType state;
+		gdk_window_get_pointer(event->motion.window, &t_x, &t_y, &state);
+		x = t_x;
+		y = t_y;
+	}
+
+	_motion.x       = x;
+	_motion.y       = y;
+	_motion.x_root  = event->motion.x_root + (x - event->motion.x);
+	_motion.y_root  = event->motion.y_root + (y - event->motion.y);
+	_motion.state   = event->motion.state;
+	_motion.item.reset();
+	_motion.pending = true;
+	queue_frame();
+	return true;
+}
+
+
+/** Defer moving the dragged @a item by (@a dx, @a dy) to the next frame.
+ *
+ * Motion is added up, so the item is moved once per frame by Item::drag_by().
+ */
+void
+Canvas::defer_drag(boost::shared_ptr<Item> item, double dx, double dy)
+{
+	if (_motion.pending && _motion.item.lock() != item)
+		flush_motion();
+
+	if (!_motion.pending) {
+		_motion.dx = 0.0;
+		_motion.dy = 0.0;
+	}
+
+	_motion.dx     += dx;
+	_motion.dy     += dy;
+	_motion.item    = item;
+	_motion.pending = true;
+	queue_frame();
+}
+
+
+/** Handle the motion deferred by defer_motion() or defer_drag(), if any. */
+void
+Canvas::flush_motion()
+{
+	if (!_motion.pending)
+		return;
 
-		if (m && m->point_is_within(x, y))
-			return m->port_at(x, y);
+	_motion.pending = false;
 
+	const boost::shared_ptr<Item> item = _motion.item.lock();
+	if (item) {
+		_motion.item.reset();
+		item->drag_by(_motion.dx, _motion.dy);
+		return;
 	}
-	return boost::shared_ptr<Port>();
+
+	if (_drag_state != SCROLL && _drag_state != CONNECTION)
+		return;
+
+	GdkEvent event;
+	memset(&event, 0, sizeof(event));
+	event.motion.type   = GDK_MOTION_NOTIFY;
+	event.motion.x      = _motion.x;
+	event.motion.y      = _motion.y;
+	event.motion.x_root = _motion.x_root;
+	event.motion.y_root = _motion.y_root;
+	event.motion.state  = _motion.state;
+
+	_motion.replaying = true;
+	if (_drag_state == SCROLL)
+		scroll_drag_handler(&event);
+	else
+		connection_drag_handler(&event);
+	_motion.replaying = false;
+}
+
+
+boost::shared_ptr<Port>
+Canvas::get_port_at(double x, double y)
+{
+	FLOWCANVAS_INSTRUMENT_SCOPE(this, OP_GET_PORT_AT);
+
+	const GraphModel::PortID port = _model.port_at(x, y);
+	return (port != GraphModel::NONE) ? _port_views[port].lock() : boost::shared_ptr<Port>();
 }
 
 
 #ifdef HAVE_AGRAPH
+/** Return the GraphViz context, which is created once and shared.
+ *
+ * Creating a context loads plugins and configuration, which is slow and not
+ * entirely freed again, so it is not worth doing for every layout.
+ */
+static GVC_t*
+gv_context()
+{
+	static GVC_t* gvc = gvContext();
+	return gvc;
+}
+
+
+/** Set a numeric GraphViz attribute, formatted in the "C" locale.
+ *
+ * GraphViz copies values into its own reference counted string pool, so
+ * the temporary string does not need to outlive this call.
+ */
+static void
+gv_set_number(void* obj, const char* name, double value, const char* def)
+{
+	std::ostringstream ss;
+	ss.imbue(std::locale::classic());
+	ss << value;
+	agsafeset(obj, const_cast<char*>(name), const_cast<char*>(ss.str().c_str()),
+	          const_cast<char*>(def));
+}
+
+
 class GVNodes : public std::map<boost::shared_ptr<Item>, Agnode_t*> {
 public:
 	GVNodes() : gvc(0), G(0) {}
 
 	void cleanup() {
-		gvFreeLayout(gvc, G);
-		agclose (G);
+		if (G) {
+			gvFreeLayout(gvc, G);
+			agclose(G);
+		}
 		gvc = 0;
 		G = 0;
 	}
@@ -1242,18 +2606,56 @@ class GVNodes : public std::map<boost::shared_ptr<Item>, void*> {};
 #endif
 
 
+/** Return the item a connection endpoint belongs to (for layout). */
+static boost::shared_ptr<Item>
+layout_item(boost::shared_ptr<Connectable> c)
+{
+	boost::shared_ptr<Port> port = boost::dynamic_pointer_cast<Port>(c);
+	if (port)
+		return port->module().lock();
+	else
+		return boost::dynamic_pointer_cast<Item>(c);
+}
+
+
+/** Get all items in a canonical order for layout.
+ *
+ * Partners and (if @a use_length_hints) connection length hints are copied
+ * to the model first, since they are only needed here.
+ */
+void
+Canvas::layout_nodes(bool use_length_hints, LayoutIDs& ids, LayoutNodes& nodes)
+{
+	for (ItemList::const_iterator i = _items.begin(); i != _items.end(); ++i) {
+		const boost::shared_ptr<Item> partner = (*i)->partner().lock();
+		_model.set_item_partner((*i)->_model_id,
+			partner ? partner->_model_id : GraphModel::NONE);
+	}
+
+	for (ConnectionList::const_iterator i = _connections.begin(); i != _connections.end(); ++i)
+		if ((*i)->_model_id != GraphModel::NONE)
+			_model.set_edge_length_hint((*i)->_model_id,
+				use_length_hints ? (*i)->length_hint() : 0.0);
+
+	_model.layout_order(ids);
+
+	nodes.clear();
+	nodes.reserve(ids.size());
+	for (LayoutIDs::const_iterator i = ids.begin(); i != ids.end(); ++i)
+		nodes.push_back(_item_views[*i].lock());
+}
+
+
 GVNodes
-Canvas::layout_dot(bool use_length_hints, const std::string& filename)
+Canvas::layout_dot(const LayoutNodes& items, bool use_length_hints, const std::string& filename)
 {
+	FLOWCANVAS_INSTRUMENT_SCOPE(this, OP_LAYOUT);
+
 	GVNodes nodes;
 
 #ifdef HAVE_AGRAPH
-	/* FIXME: Are the strdup's here a leak?
-	 * GraphViz documentation disagrees with function prototypes.
-	 */
-
-	GVC_t* gvc = gvContext();
-	Agraph_t* G = agopen((char*)"g", AGDIGRAPH);
+	GVC_t*    gvc = gv_context();
+	Agraph_t* G   = agopen((char*)"g", AGDIGRAPH);
 
 	nodes.gvc = gvc;
 	nodes.G = G;
@@ -1263,45 +2665,30 @@ Canvas::layout_dot(bool use_length_hints, const std::string& filename)
 	else
 		agraphattr(G, (char*)"rankdir", (char*)"TD");
 
+	char name[16];
 	unsigned id = 0;
-	for (ItemList::const_iterator i = _items.begin(); i != _items.end(); ++i) {
-		std::ostringstream ss;
-		ss << "n" << id++;
-		Agnode_t* node = agnode(G, strdup(ss.str().c_str()));
+	for (LayoutNodes::const_iterator i = items.begin(); i != items.end(); ++i) {
+		snprintf(name, sizeof(name), "n%u", id++);
+		Agnode_t* node = agnode(G, name);
+		assert(node);
 		if (boost::dynamic_pointer_cast<Module>(*i)) {
-			ss.str("");
-			ss << (*i)->width() / 96.0;
-			agsafeset(node, (char*)"width", strdup(ss.str().c_str()), (char*)"");
-			ss.str("");
-			ss << (*i)->height() / 96.0;
-			agsafeset(node, (char*)"height", strdup(ss.str().c_str()), (char*)"");
+			gv_set_number(node, "width", (*i)->width() / 96.0, "");
+			gv_set_number(node, "height", (*i)->height() / 96.0, "");
 			agsafeset(node, (char*)"shape", (char*)"box", (char*)"");
-			agsafeset(node, (char*)"label", (char*)(*i)->name().c_str(), (char*)"");
 		} else {
 			agsafeset(node, (char*)"width", (char*)"1.0", (char*)"");
 			agsafeset(node, (char*)"height", (char*)"1.0", (char*)"");
 			agsafeset(node, (char*)"shape", (char*)"ellipse", (char*)"");
-			agsafeset(node, (char*)"label", (char*)(*i)->name().c_str(), (char*)"");
 		}
-		assert(node);
+		agsafeset(node, (char*)"label", (char*)(*i)->name().c_str(), (char*)"");
 		nodes.insert(std::make_pair(*i, node));
 	}
 
 	for (ConnectionList::iterator i = _connections.begin(); i != _connections.end(); ++i) {
 		const boost::shared_ptr<Connection> c = *i;
 
-		boost::shared_ptr<Port> src_port = boost::dynamic_pointer_cast<Port>(c->source().lock());
-		boost::shared_ptr<Port> dst_port = boost::dynamic_pointer_cast<Port>(c->dest().lock());
-		boost::shared_ptr<Item> src_item = boost::dynamic_pointer_cast<Item>(c->source().lock());
-		boost::shared_ptr<Item> dst_item = boost::dynamic_pointer_cast<Item>(c->dest().lock());
-
-		GVNodes::iterator src_i = src_port
-			? nodes.find(src_port->module().lock())
-			: nodes.find(src_item);
-
-		GVNodes::iterator dst_i = dst_port
-			? nodes.find(dst_port->module().lock())
-			: nodes.find(dst_item);
+		GVNodes::iterator src_i = nodes.find(layout_item(c->source().lock()));
+		GVNodes::iterator dst_i = nodes.find(layout_item(c->dest().lock()));
 
 		assert(src_i != nodes.end() && dst_i != nodes.end());
 
@@ -1312,30 +2699,32 @@ Canvas::layout_dot(bool use_length_hints, const std::string& filename)
 
 		Agedge_t* edge = agedge(G, src_node, dst_node);
 
-		if (use_length_hints && c->length_hint() != 0) {
-			std::ostringstream len_ss;
-			len_ss << c->length_hint();
-			agsafeset(edge, (char*)"minlen", strdup(len_ss.str().c_str()), (char*)"1.0");
-		}
+		if (use_length_hints && c->length_hint() != 0)
+			gv_set_number(edge, "minlen", c->length_hint(), "1.0");
 	}
 
 	// Add edges between partners to have them lined up as if they are connected
-	for (GVNodes::iterator i = nodes.begin(); i != nodes.end(); ++i) {
-		boost::shared_ptr<Item> partner = i->first->partner().lock();
+	for (LayoutNodes::const_iterator i = items.begin(); i != items.end(); ++i) {
+		boost::shared_ptr<Item> partner = (*i)->partner().lock();
 		if (partner) {
 			GVNodes::iterator p = nodes.find(partner);
 			if (p != nodes.end())
-				agedge(G, i->second, p->second);
+				agedge(G, nodes[*i], p->second);
 		}
 	}
 
+	// Node coordinates are read directly from the layout, rendering is only
+	// necessary to write a file
 	gvLayout(gvc, G, (char*)"dot");
-	gvRender(gvc, G, (char*)"dot", fopen("/dev/null", "w"));
 
 	if (filename != "") {
 		FILE* fd = fopen(filename.c_str(), "w");
-		gvRender(gvc, G, (char*)"dot", fd);
-		fclose(fd);
+		if (fd) {
+			gvRender(gvc, G, (char*)"dot", fd);
+			fclose(fd);
+		} else {
+			cerr << "Unable to open " << filename << endl;
+		}
 	}
 #endif
 
@@ -1347,44 +2736,72 @@ void
 Canvas::render_to_dot(const string& dot_output_filename)
 {
 #ifdef HAVE_AGRAPH
-	GVNodes nodes = layout_dot(false, dot_output_filename);
+	LayoutIDs   ids;
+	LayoutNodes items;
+	layout_nodes(false, ids, items);
+
+	GVNodes nodes = layout_dot(items, false, dot_output_filename);
 	nodes.cleanup();
 #endif
 }
 
 
+/** Set the file used to remember arrange() results between sessions.
+ *
+ * Arranging a graph that has been arranged before (with the same topology,
+ * item sizes, direction and length hints) reuses the stored positions
+ * instead of running GraphViz.  Pass the empty string to only cache in memory.
+ */
 void
-Canvas::arrange(bool use_length_hints, bool center)
+Canvas::set_layout_cache_file(const string& filename)
 {
-#ifdef HAVE_AGRAPH
-	GVNodes nodes = layout_dot(use_length_hints, "");
+	_layout_cache->set_filename(filename);
+}
 
-	double least_x=HUGE_VAL, least_y=HUGE_VAL, most_x=0, most_y=0;
 
-	// Set numeric locale to POSIX for reading graphviz output with strtod
-	char* locale = strdup(setlocale(LC_NUMERIC, NULL));
-	setlocale(LC_NUMERIC, "POSIX");
+void
+Canvas::clear_layout_cache()
+{
+	_layout_cache->clear();
+}
+
 
-	// Arrange to graphviz coordinates
-	for (GVNodes::iterator i = nodes.begin(); i != nodes.end(); ++i) {
-		const string pos   = agget(i->second, (char*)"pos");
-		const string x_str = pos.substr(0, pos.find(","));
-		const string y_str = pos.substr(pos.find(",")+1);
-		const double x     = strtod(x_str.c_str(), NULL) * 1.25;
-		const double y     = -strtod(y_str.c_str(), NULL) * 1.25;
+void
+Canvas::arrange(bool use_length_hints, bool center)
+{
+	FLOWCANVAS_INSTRUMENT_SCOPE(this, OP_ARRANGE);
 
-		i->first->property_x() = x - i->first->width()/2.0;
-		i->first->property_y() = y - i->first->height()/2.0;
+#ifdef HAVE_AGRAPH
+	LayoutIDs   ids;
+	LayoutNodes nodes;
+	layout_nodes(use_length_hints, ids, nodes);
+
+	const uint64_t key = _model.layout_key(ids, uint32_t(_direction));
+
+	// Only run GraphViz if this graph hasn't been arranged before
+	LayoutCache::Positions positions;
+	if (!_layout_cache->find(key, nodes.size(), positions)) {
+		GVNodes gv_nodes = layout_dot(nodes, use_length_hints, "");
+
+		// Read graphviz coordinates (in points, y up) in canonical node order
+		positions.reserve(nodes.size());
+		for (LayoutNodes::const_iterator i = nodes.begin(); i != nodes.end(); ++i) {
+			Agnode_t* node = gv_nodes[*i];
+			positions.push_back(std::make_pair(ND_coord(node).x * 1.25,
+			                                   -ND_coord(node).y * 1.25));
+		}
 
-		least_x = std::min(least_x, x);
-		least_y = std::min(least_y, y);
-		most_x  = std::max(most_x, x);
-		most_y  = std::max(most_y, y);
+		gv_nodes.cleanup();
+		_layout_cache->insert(key, positions);
 	}
 
-	// Reset numeric locale to original value
-	setlocale(LC_NUMERIC, locale);
-	free(locale);
+	double least_x=HUGE_VAL, least_y=HUGE_VAL, most_x=0, most_y=0;
+	for (LayoutCache::Positions::const_iterator p = positions.begin(); p != positions.end(); ++p) {
+		least_x = std::min(least_x, p->first);
+		least_y = std::min(least_y, p->second);
+		most_x  = std::max(most_x, p->first);
+		most_y  = std::max(most_y, p->second);
+	}
 
 	const double graph_width  = most_x - least_x;
 	const double graph_height = most_y - least_y;
@@ -1398,43 +2815,240 @@ Canvas::arrange(bool use_length_hints, bool center)
 	if (graph_height + 10 > _height)
 		resize(_width, graph_height + 10);
 
-	nodes.cleanup();
+	static const double border_width = 64.0;
+
+	const double x_offset = (center ? _width / 2.0 - (graph_width / 2.0) : border_width) - least_x;
+	const double y_offset = (center ? _height / 2.0 - (graph_height / 2.0) : border_width) - least_y;
 
-	if (center) {
-		move_contents_to_internal(
-				_width / 2.0 - (graph_width / 2.0),
-				_height / 2.0 - (graph_height / 2.0), least_x, least_y);
+	// Move everything to graphviz coordinates in one pass
+	ItemPositions new_positions;
+	for (size_t i = 0; i < nodes.size(); ++i)
+		new_positions.insert(std::make_pair(nodes[i], Gnome::Art::Point(
+			positions[i].first - nodes[i]->width() / 2.0 + x_offset,
+			positions[i].second - nodes[i]->height() / 2.0 + y_offset)));
+
+	animate_positions(new_positions);
+
+	if (center)
 		scroll_to_center();
-	} else {
-		static const double border_width = 64.0;
-		move_contents_to_internal(border_width, border_width, least_x, least_y);
+	else
 		scroll_to(0, 0);
-	}
+#endif
+}
+
 
+void
+Canvas::move_contents_to(double x, double y)
+{
+	double min_x, min_y, max_x, max_y;
+	if (!get_contents_bounds(min_x, min_y, max_x, max_y))
+		return;
+
+	ItemPositions positions;
 	for (ItemList::const_iterator i = _items.begin(); i != _items.end(); ++i)
+		positions.insert(std::make_pair(*i, Gnome::Art::Point(
+			(*i)->property_x() + x - min_x,
+			(*i)->property_y() + y - min_y)));
+
+	apply_positions(positions);
+}
+
+
+/** Add the connections to/from @a item (or its ports) to @a connections. */
+static void
+add_item_connections(boost::shared_ptr<Item> item, std::set< boost::shared_ptr<Connection> >& connections)
+{
+	std::vector<Connectable*> connectables;
+
+	boost::shared_ptr<Module> module = boost::dynamic_pointer_cast<Module>(item);
+	if (module)
+		for (PortVector::const_iterator p = module->ports().begin(); p != module->ports().end(); ++p)
+			connectables.push_back(p->get());
+
+	Connectable* connectable = dynamic_cast<Connectable*>(item.get());
+	if (connectable)
+		connectables.push_back(connectable);
+
+	for (std::vector<Connectable*>::iterator c = connectables.begin(); c != connectables.end(); ++c) {
+		for (Connectable::Connections::const_iterator i = (*c)->connections().begin();
+				i != (*c)->connections().end(); ++i) {
+			boost::shared_ptr<Connection> connection = i->lock();
+			if (connection)
+				connections.insert(connection);
+		}
+	}
+}
+
+
+/** Move items to absolute positions, rerouting each connection once.
+ *
+ * Items that actually moved are appended to @a moved.
+ */
+void
+Canvas::move_items(const ItemPositions& positions, ItemList& moved)
+{
+	FLOWCANVAS_INSTRUMENT_SCOPE(this, OP_MOVE_ITEMS);
+
+	std::set< boost::shared_ptr<Connection> > dirty;
+
+	double width  = _width;
+	double height = _height;
+	for (ItemPositions::const_iterator i = positions.begin(); i != positions.end(); ++i) {
+		const boost::shared_ptr<Item>& item = i->first;
+		const double x = std::max(0.0, i->second.get_x());
+		const double y = std::max(0.0, i->second.get_y());
+		if (x == item->property_x() && y == item->property_y())
+			continue;
+
+		item->property_x() = x;
+		item->property_y() = y;
+
+		// Actually move (stupid gnomecanvas)
+		item->Gnome::Canvas::Group::move(0, 0);
+		item->update_bounds();
+
+		add_item_connections(item, dirty);
+		moved.push_back(item);
+
+		width  = std::max(width, x + item->width() + 5.0);
+		height = std::max(height, y + item->height() + 5.0);
+	}
+
+	for (std::set< boost::shared_ptr<Connection> >::iterator c = dirty.begin(); c != dirty.end(); ++c)
+		(*c)->update_location();
+
+	expand(width, height);
+}
+
+
+/** Move many items to absolute positions (in world units) at once.
+ *
+ * All items are moved first, then every affected connection is rerouted
+ * exactly once and the canvas is grown to fit once, which is much faster
+ * than moving items one at a time.  Item::store_location() is called on each
+ * moved item, and signal_items_moved is emitted once for the whole batch.
+ */
+void
+Canvas::apply_positions(const ItemPositions& positions)
+{
+	ItemList moved;
+	move_items(positions, moved);
+	if (moved.empty())
+		return;
+
+	for (ItemList::const_iterator i = moved.begin(); i != moved.end(); ++i)
 		(*i)->store_location();
 
-#endif
+	signal_items_moved.emit(moved);
 }
 
 
+/** Move many items to absolute positions with an animated transition.
+ *
+ * Items are smoothly moved from their current positions over
+ * animation_duration() seconds, one batched move per frame.  When the
+ * animation is finished, the result is exactly as if apply_positions() had
+ * been called.  If animation is disabled, this is apply_positions().
+ */
 void
-Canvas::move_contents_to(double x, double y)
+Canvas::animate_positions(const ItemPositions& positions)
 {
-	double min_x=HUGE_VAL, min_y=HUGE_VAL;
-	for (ItemList::const_iterator i = _items.begin(); i != _items.end(); ++i) {
-		min_x = std::min(min_x, double((*i)->property_x()));
-		min_y = std::min(min_y, double((*i)->property_y()));
+	if (_animation_duration <= 0.0) {
+		_transition_from.clear();
+		_transition_to.clear();
+		apply_positions(positions);
+		return;
+	}
+
+	// Start from current positions (possibly part way through an animation)
+	_transition_from.clear();
+	for (ItemPositions::const_iterator i = positions.begin(); i != positions.end(); ++i)
+		_transition_from.insert(std::make_pair(i->first, Gnome::Art::Point(
+			i->first->property_x(), i->first->property_y())));
+
+	// Items still moving from a previous transition finish moving now
+	ItemPositions pending;
+	for (ItemPositions::const_iterator i = _transition_to.begin(); i != _transition_to.end(); ++i)
+		if (positions.find(i->first) == positions.end())
+			pending.insert(*i);
+
+	_transition_to = positions;
+	if (!pending.empty())
+		apply_positions(pending);
+
+	Glib::TimeVal now;
+	now.assign_current_time();
+	_transition_start = now.as_double();
+
+	queue_frame();
+}
+
+
+/** Move items for the current frame of a running animation.
+ *
+ * Returns true if the animation needs more frames.
+ */
+bool
+Canvas::animate_transition()
+{
+	if (_transition_to.empty())
+		return false;
+
+	Glib::TimeVal now;
+	now.assign_current_time();
+
+	const double t = std::min(1.0, (now.as_double() - _transition_start) / _animation_duration);
+	if (t >= 1.0) {
+		ItemPositions positions;
+		positions.swap(_transition_to);
+		_transition_from.clear();
+		apply_positions(positions);
+		return false;
+	}
+
+	// Ease in and out
+	const double s = t * t * (3.0 - 2.0 * t);
+
+	ItemPositions frame;
+	for (ItemPositions::const_iterator i = _transition_to.begin(); i != _transition_to.end(); ++i) {
+		const Gnome::Art::Point& from = _transition_from[i->first];
+		frame.insert(std::make_pair(i->first, Gnome::Art::Point(
+			from.get_x() + (i->second.get_x() - from.get_x()) * s,
+			from.get_y() + (i->second.get_y() - from.get_y()) * s)));
 	}
-	move_contents_to_internal(x, y, min_x, min_y);
+
+	ItemList moved;
+	move_items(frame, moved);
+	return true;
 }
 
 
+/** Ensure on_frame() will be called on the next frame. */
 void
-Canvas::move_contents_to_internal(double x, double y, double min_x, double min_y)
+Canvas::queue_frame()
 {
-	for (ItemList::const_iterator i = _items.begin(); i != _items.end(); ++i)
-		(*i)->move(x - min_x, y - min_y);
+	if (!_frame_connection.connected())
+		_frame_connection = Glib::signal_timeout().connect(
+			sigc::mem_fun(this, &Canvas::on_frame), FRAME_INTERVAL_MS);
+}
+
+
+/** Per-frame work, run from a single timeout only while something needs it.
+ *
+ * GTK2 has no frame clock, so a timeout at the nominal display rate stands
+ * in for one.  Returns false (stopping the timeout) when idle.
+ */
+bool
+Canvas::on_frame()
+{
+	FLOWCANVAS_INSTRUMENT_SCOPE(this, OP_FRAME);
+
+	flush_motion();
+
+	bool more = false;
+	more |= animate_transition();
+	more |= apply_control_stream();
+	return more;
 }
 
 
@@ -1451,6 +3065,24 @@ Canvas::resize(double width, double height)
 }
 
 
+/** Grow the canvas (if necessary) to be at least @a width by @a height.
+ *
+ * The canvas grows geometrically, so adding or moving many items one at a
+ * time only resets the scroll region a logarithmic number of times.
+ */
+void
+Canvas::expand(double width, double height)
+{
+	static const double growth = 1.5;
+
+	if (width <= _width && height <= _height)
+		return;
+
+	resize((width > _width) ? std::max(width, _width * growth) : _width,
+	       (height > _height) ? std::max(height, _height * growth) : _height);
+}
+
+
 void
 Canvas::resize_all_items()
 {
@@ -0,0 +1,43 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+#ifndef FLOWCANVAS_CLOCK_HPP
+#define FLOWCANVAS_CLOCK_HPP
+
+#include <stdint.h>
+
+#include <glib.h>
+
+namespace FlowCanvas {
+
+
+/** Current time in microseconds, from a clock that never jumps.
+ *
+ * Only differences between two values mean anything, so time budgets and
+ * measurements are unaffected by changes to the system time.
+ */
+inline uint64_t
+monotonic_us()
+{
+	return uint64_t(g_get_monotonic_time());
+}
+
+
+} // namespace FlowCanvas
+
+#endif // FLOWCANVAS_CLOCK_HPP
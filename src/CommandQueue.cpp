@@ -0,0 +1,165 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+#include <cstring>
+#include <map>
+#include <string>
+
+#include "CommandQueue.hpp"
+
+namespace FlowCanvas {
+
+
+GraphCommand::GraphCommand(Type t)
+	: type(t)
+	, is_input(false)
+	, color(0)
+	, value(0.0f)
+	, x(0.0)
+	, y(0.0)
+{
+	module[0] = port[0] = head_module[0] = head_port[0] = name[0] = '\0';
+}
+
+
+bool
+GraphCommand::set(char (&dst)[MAX_STRING], const char* src)
+{
+	if (!src)
+		return false;
+
+	const size_t len = strlen(src);
+	if (len >= MAX_STRING)
+		return false;
+
+	memcpy(dst, src, len + 1);
+	return true;
+}
+
+
+CommandQueue::CommandQueue(unsigned order)
+	: _cells(new Cell[1u << order])
+	, _mask((1u << order) - 1)
+	, _tail(0)
+	, _head(0)
+{
+	for (guint i = 0; i <= _mask; ++i)
+		_cells[i].seq = gint(i);
+}
+
+
+CommandQueue::~CommandQueue()
+{
+	delete[] _cells;
+}
+
+
+bool
+CommandQueue::push(const GraphCommand& command)
+{
+	guint pos = guint(g_atomic_int_get(&_tail));
+	for (;;) {
+		Cell&      cell = _cells[pos & _mask];
+		const gint diff = gint(guint(g_atomic_int_get(&cell.seq)) - pos);
+		if (diff == 0) {
+			if (g_atomic_int_compare_and_exchange(&_tail, gint(pos), gint(pos + 1))) {
+				cell.command = command;
+				g_atomic_int_set(&cell.seq, gint(pos + 1));
+				return true;
+			}
+		} else if (diff < 0) {
+			return false; // Full
+		}
+		pos = guint(g_atomic_int_get(&_tail));
+	}
+}
+
+
+void
+CommandQueue::take()
+{
+	for (;;) {
+		Cell& cell = _cells[_head & _mask];
+		if (guint(g_atomic_int_get(&cell.seq)) != _head + 1)
+			break;
+
+		_pending.push_back(cell.command);
+		g_atomic_int_set(&cell.seq, gint(_head + _mask + 1));
+		++_head;
+	}
+}
+
+
+/** Return a key identifying what @a c acts on, for coalesce(). */
+static std::string
+command_key(const GraphCommand& c)
+{
+	std::string key(1, (c.type == GraphCommand::DISCONNECT) ? char(GraphCommand::CONNECT) : char(c.type));
+	key.append(c.module).append(1, '\0').append(c.port);
+	if (c.type == GraphCommand::CONNECT || c.type == GraphCommand::DISCONNECT)
+		key.append(1, '\0').append(c.head_module).append(1, '\0').append(c.head_port);
+	return key;
+}
+
+
+void
+CommandQueue::coalesce()
+{
+	typedef std::map<std::string, size_t> Latest;
+
+	Latest            latest; // Index of last command for each key
+	std::vector<bool> dead(_pending.size(), false);
+
+	for (size_t i = 0; i < _pending.size(); ++i) {
+		const GraphCommand& c = _pending[i];
+		switch (c.type) {
+		case GraphCommand::ADD_MODULE:
+		case GraphCommand::REMOVE_MODULE:
+		case GraphCommand::ADD_PORT:
+		case GraphCommand::REMOVE_PORT:
+			latest.clear();
+			break;
+
+		case GraphCommand::CONNECT:
+		case GraphCommand::DISCONNECT:
+		case GraphCommand::RENAME_MODULE:
+		case GraphCommand::RENAME_PORT:
+		case GraphCommand::SET_CONTROL: {
+			const std::string key = command_key(c);
+			Latest::iterator  l   = latest.find(key);
+			if (l == latest.end()) {
+				latest.insert(std::make_pair(key, i));
+			} else {
+				dead[l->second] = true; // Superseded
+				l->second       = i;
+			}
+			break;
+		}
+		}
+	}
+
+	size_t n = 0;
+	for (size_t i = 0; i < _pending.size(); ++i)
+		if (!dead[i])
+			_pending[n++] = _pending[i];
+
+	_pending.erase(_pending.begin() + n, _pending.end());
+}
+
+
+} // namespace FlowCanvas
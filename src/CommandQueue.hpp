@@ -0,0 +1,128 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+#ifndef FLOWCANVAS_COMMANDQUEUE_HPP
+#define FLOWCANVAS_COMMANDQUEUE_HPP
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <glib.h>
+
+namespace FlowCanvas {
+
+
+/** A graph change posted to a Canvas from another thread.
+ *
+ * Objects are named by the same IDs as in GraphDescription.  Strings are
+ * stored inline so that posting a command never allocates.
+ */
+struct GraphCommand {
+	enum Type {
+		ADD_MODULE,
+		REMOVE_MODULE,
+		ADD_PORT,
+		REMOVE_PORT,
+		CONNECT,
+		DISCONNECT,
+		RENAME_MODULE,
+		RENAME_PORT,
+		SET_CONTROL
+	};
+
+	enum { MAX_STRING = 64 }; ///< Including terminating nul
+
+	/** Set all fields to empty values. */
+	explicit GraphCommand(Type t);
+
+	/** Copy @a src to @a dst, returning false if it is NULL or too long. */
+	static bool set(char (&dst)[MAX_STRING], const char* src);
+
+	uint8_t  type;
+	bool     is_input;
+	uint32_t color;
+	float    value;
+	double   x;
+	double   y;
+	char     module[MAX_STRING];      ///< Module, or tail module of a connection
+	char     port[MAX_STRING];        ///< Port, or tail port of a connection
+	char     head_module[MAX_STRING];
+	char     head_port[MAX_STRING];
+	char     name[MAX_STRING];        ///< New name (add and rename)
+};
+
+
+/** Bounded lock-free queue of GraphCommands.
+ *
+ * Any number of threads may push(), and only the GUI thread takes commands
+ * out.  This is the usual bounded queue with a sequence number in each
+ * cell: a producer claims a cell by advancing the tail with compare and
+ * exchange, and publishes it by setting the cell's sequence number, so no
+ * thread ever waits for another.  A full queue makes push() fail rather
+ * than block.
+ */
+class CommandQueue {
+public:
+	/** Create a queue with room for 2^@a order commands. */
+	explicit CommandQueue(unsigned order);
+	~CommandQueue();
+
+	/** Add a command (any thread).  Returns false if the queue is full. */
+	bool push(const GraphCommand& command);
+
+	/** Move all posted commands to pending() (GUI thread only). */
+	void take();
+
+	/** Commands taken but not yet applied, in order (GUI thread only). */
+	std::vector<GraphCommand>& pending() { return _pending; }
+
+	/** Remove pending commands that have no overall effect.
+	 *
+	 * Only the last connect or disconnect of a pair, and the last rename or
+	 * control value for an object, is kept.  A connect followed by a
+	 * disconnect is not dropped entirely, since the pair may have been
+	 * connected beforehand.  Adding or removing a module or port ends the
+	 * span over which commands are combined.
+	 */
+	void coalesce();
+
+	size_t memory_bytes() const {
+		return sizeof(CommandQueue) + (_mask + 1) * sizeof(Cell)
+			+ _pending.capacity() * sizeof(GraphCommand);
+	}
+
+private:
+	struct Cell {
+		Cell() : seq(0), command(GraphCommand::CONNECT) {}
+
+		volatile gint seq; ///< Position + 1 when full, position when free
+		GraphCommand  command;
+	};
+
+	Cell*                     _cells;
+	const guint               _mask;
+	volatile gint             _tail;    ///< Next position to push to
+	guint                     _head;    ///< Next position to take from
+	std::vector<GraphCommand> _pending;
+};
+
+
+} // namespace FlowCanvas
+
+#endif // FLOWCANVAS_COMMANDQUEUE_HPP
@@ -15,7 +15,7 @@
  * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
  */
 
-#include <list>
+#include <cassert>
 
 #include <boost/weak_ptr.hpp>
 
@@ -23,22 +23,23 @@
 
 #include "flowcanvas/Connectable.hpp"
 #include "flowcanvas/Connection.hpp"
-
-using std::list;
+#include "MemoryAccounting.hpp"
 
 namespace FlowCanvas {
 
 
+Connectable::~Connectable()
+{
+	clear_connections();
+}
+
+
 /** Update the location of all connections to/from this item if we've moved */
 void
 Connectable::move_connections()
 {
-	for (list<boost::weak_ptr<Connection> >::iterator i = _connections.begin(); i != _connections.end(); i++) {
-		boost::shared_ptr<Connection> c = i->lock();
-		if (c) {
-			c->update_location();
-		}
-	}
+	for (Connections::iterator i = _connections.begin(); i != _connections.end(); ++i)
+		i->get()->update_location();
 }
 
 
@@ -49,20 +50,24 @@ Connectable::move_connections()
 void
 Connectable::add_connection(boost::shared_ptr<Connection> connection)
 {
-	/*if (is_output())
-		assert(connection->source().lock().get() == this);
-	else if (is_input())
-		assert(connection->dest().lock().get() == this);*/
-	assert(connection->source().lock().get() == this
-		|| connection->dest().lock().get() == this);
-
-	for (list<boost::weak_ptr<Connection> >::iterator i = _connections.begin(); i != _connections.end(); i++) {
-		boost::shared_ptr<Connection> c = (*i).lock();
-		if (c && c == connection)
-			return;
+	const unsigned end = (connection->_ends[0] == this) ? 0 : 1;
+	assert(connection->_ends[end] == this);
+
+	if (connection->_slots[end] != Connection::NO_SLOT)
+		return; // Already added
+
+	connection->_slots[end] = _connections.size();
+	_connections.push_back(Ref(connection));
+
+	if (_peers) {
+		add_peer(connection->_ends[!end]);
+	} else if (_connections.size() >= PEER_INDEX_DEGREE) {
+		_peers = new Peers();
+		for (Connections::iterator i = _connections.begin(); i != _connections.end(); ++i) {
+			Connection* const c = i->get();
+			add_peer(c->_ends[c->_ends[0] == this ? 1 : 0]);
+		}
 	}
-
-	_connections.push_back(connection);
 }
 
 
@@ -73,34 +78,115 @@ Connectable::add_connection(boost::shared_ptr<Connection> connection)
 void
 Connectable::remove_connection(boost::shared_ptr<Connection> c)
 {
-	for (list<boost::weak_ptr<Connection> >::iterator i = _connections.begin(); i != _connections.end(); i++) {
-		boost::shared_ptr<Connection> connection = i->lock();
-		if (connection && connection == c) {
-			_connections.erase(i);
-			break;
+	for (unsigned end = 0; end < 2; ++end) {
+		const uint32_t slot = c->_slots[end];
+		if (c->_ends[end] == this && slot != Connection::NO_SLOT) {
+			assert(_connections[slot].get() == c.get());
+			detach(c.get(), end);
+			return;
 		}
 	}
 }
 
 
+/** Remove @a c (whose @a end is this) by moving the last connection into its slot. */
 void
-Connectable::raise_connections()
+Connectable::detach(Connection* c, unsigned end)
 {
-	for (list<boost::weak_ptr<Connection> >::iterator i = _connections.begin(); i != _connections.end(); ++i) {
-		boost::shared_ptr<Connection> connection = (*i).lock();
-		if (connection)
-			connection->raise_to_top();
+	const uint32_t slot = c->_slots[end];
+	const uint32_t last = _connections.size() - 1;
+	c->_slots[end] = Connection::NO_SLOT;
+
+	if (slot != last) {
+		_connections[slot] = _connections.back();
+		Connection* const moved = _connections[slot].get();
+		const unsigned moved_end = (moved->_ends[0] == this && moved->_slots[0] == last) ? 0 : 1;
+		moved->_slots[moved_end] = slot;
+	}
+	_connections.pop_back();
+
+	if (_peers) {
+		remove_peer(c->_ends[!end]);
+		if (_connections.size() < PEER_INDEX_DEGREE / 2) {
+			delete _peers;
+			_peers = NULL;
+		}
+	}
+}
 
+
+/** Remove all connections from this item (without removing them from the canvas).
+ *
+ * The connections forget this end, so they can outlive it.
+ */
+void
+Connectable::clear_connections()
+{
+	for (Connections::iterator i = _connections.begin(); i != _connections.end(); ++i) {
+		Connection* const c   = i->get();
+		const unsigned    end = (c->_ends[0] == this && c->_slots[0] != Connection::NO_SLOT) ? 0 : 1;
+		Connectable* const peer = c->_ends[!end];
+		c->_slots[end] = Connection::NO_SLOT;
+		c->_ends[end]  = NULL;
+		if (c->_slots[!end] != Connection::NO_SLOT && peer != this && peer->_peers)
+			peer->remove_peer(this);
 	}
+
+	_connections.clear();
+	delete _peers;
+	_peers = NULL;
+}
+
+
+void
+Connectable::add_peer(const Connectable* peer)
+{
+	if (peer)
+		++(*_peers)[peer];
+}
+
+
+void
+Connectable::remove_peer(const Connectable* peer)
+{
+	Peers::iterator p = _peers->find(peer);
+	if (p != _peers->end() && --p->second == 0)
+		_peers->erase(p);
+}
+
+
+/** Return the number of bytes used by the connection vector and peer index. */
+size_t
+Connectable::connections_heap_bytes() const
+{
+	return _connections.heap_bytes() + (_peers ? sizeof(Peers) + map_heap_bytes(*_peers) : 0);
+}
+
+
+/** Raise all connections above items (see Connection::set_raised). */
+void
+Connectable::raise_connections()
+{
+	for (Connections::iterator i = _connections.begin(); i != _connections.end(); ++i)
+		i->get()->set_raised(true);
 }
 
 
 bool
 Connectable::is_connected_to(boost::shared_ptr<Connectable> other)
 {
-	for (list<boost::weak_ptr<Connection> >::iterator i = _connections.begin(); i != _connections.end(); ++i) {
-		boost::shared_ptr<Connection> connection = (*i).lock();
-		if (connection->source().lock() == other || connection->dest().lock() == other)
+	const Connectable* const peer = other.get();
+	if (!peer)
+		return false;
+	else if (peer == this)
+		return !_connections.empty();
+
+	if (_peers)
+		return _peers->find(peer) != _peers->end();
+
+	for (Connections::iterator i = _connections.begin(); i != _connections.end(); ++i) {
+		const Connection* const c = i->get();
+		if (c->_ends[0] == peer || c->_ends[1] == peer)
 			return true;
 	}
 
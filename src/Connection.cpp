@@ -26,6 +26,8 @@
 #include "flowcanvas/Connectable.hpp"
 #include "flowcanvas/Connection.hpp"
 #include "flowcanvas/Ellipse.hpp"
+#include "MemoryAccounting.hpp"
+#include "ScopedOperation.hpp"
 
 namespace FlowCanvas {
 
@@ -35,7 +37,7 @@ Connection::Connection(boost::shared_ptr<Canvas>      canvas,
 	                   boost::shared_ptr<Connectable> dest,
                        uint32_t                       color,
                        bool                           show_arrowhead)
-	: Gnome::Canvas::Group(*canvas->root())
+	: Gnome::Canvas::Group(*canvas->layer(Canvas::LAYER_CONNECTIONS))
 	, _canvas(canvas)
 	, _source(source)
 	, _dest(dest)
@@ -44,23 +46,50 @@ Connection::Connection(boost::shared_ptr<Canvas>      canvas,
 	, _handle(NULL)
 	, _color(color)
 	, _handle_style(HANDLE_NONE)
+	, _model_id(GraphModel::NONE)
 	, _selected(false)
 	, _show_arrowhead(show_arrowhead)
+	, _raised(false)
 {
+	_ends[0]  = source.get();
+	_ends[1]  = dest.get();
+	_slots[0] = _slots[1] = NO_SLOT;
+
 	_bpath.property_width_units() = 2.0;
 	set_color(color);
 
 	update_location();
-	raise_to_top();
 }
 
 
 Connection::~Connection()
 {
+	for (unsigned end = 0; end < 2; ++end)
+		if (_slots[end] != NO_SLOT)
+			_ends[end]->detach(this, end);
+
 	gnome_canvas_path_def_unref(_path);
 }
 
 
+void
+Connection::account_memory(MemoryReport& report) const
+{
+	MemoryUsage& usage = report[MEM_CONNECTIONS];
+	++usage.count;
+	usage.object_bytes  += sizeof(Connection) + SHARED_COUNT_BYTES;
+	usage.gobject_bytes += group_gobject_bytes(*this) + item_gobject_bytes(&_bpath);
+	if (_path)
+		usage.object_bytes += gnome_canvas_path_def_length(_path) * sizeof(ArtBpath);
+
+	if (_handle) {
+		usage.object_bytes  += sizeof(Handle);
+		usage.gobject_bytes += group_gobject_bytes(*_handle) + item_gobject_bytes(_handle->shape);
+		account_text(usage, _handle->text);
+	}
+}
+
+
 void
 Connection::set_color(uint32_t color)
 {
@@ -83,6 +112,8 @@ Connection::set_color(uint32_t color)
 void
 Connection::update_location()
 {
+	FLOWCANVAS_INSTRUMENT_SCOPE(_canvas, OP_UPDATE_CONNECTION);
+
 	boost::shared_ptr<Connectable> src = _source.lock();
 	boost::shared_ptr<Connectable> dst = _dest.lock();
 
@@ -302,29 +333,24 @@ Connection::set_selected(bool selected)
 }
 
 
-/** Overloaded Gnome::Canvas::Item::raise_to_top to ensure src and dst
- * are still above connections (to hide the part behind connected Ellipses).
+/** Move this connection above all items, or back below them.
+ *
+ * Connections normally live in a layer below items (which hides the part
+ * behind connected Ellipses), a raised one is moved to the highlighted
+ * layer above them.  Nothing else on the canvas is restacked.
  */
 void
-Connection::raise_to_top()
+Connection::set_raised(bool raised)
 {
-	Gnome::Canvas::Item::raise_to_top();
-
-	// Raise source above us
-	boost::shared_ptr<Item> item = boost::dynamic_pointer_cast<Item>(_source.lock());
-	if (item)
-		item->raise_to_top();
-
-	// Raise dest above us
-	item = boost::dynamic_pointer_cast<Item>(_dest.lock());
-	if (item)
-		item->raise_to_top();
-
-	/* Raise the roof
-	       \o/
-	        |
-	       / \
-	*/
+	if (raised == _raised)
+		return;
+
+	boost::shared_ptr<Canvas> canvas = _canvas.lock();
+	if (!canvas)
+		return;
+
+	_raised = raised;
+	reparent(*canvas->layer(raised ? Canvas::LAYER_HIGHLIGHTED : Canvas::LAYER_CONNECTIONS));
 }
 
 
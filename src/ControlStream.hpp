@@ -0,0 +1,125 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+#ifndef FLOWCANVAS_CONTROLSTREAM_HPP
+#define FLOWCANVAS_CONTROLSTREAM_HPP
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <glib.h>
+
+namespace FlowCanvas {
+
+class Port;
+
+
+/** Latest control value for each of a set of ports.
+ *
+ * Any thread may write() a value for a port by handle; this is two atomic
+ * stores, so writing as often as values arrive is cheap.  The canvas reads
+ * each changed slot once per frame, so only the latest value is applied.
+ */
+class ControlStream {
+public:
+	struct Slot {
+		Slot() : bits(0), dirty(0), value(0.0f), used(false), pending(false) {}
+
+		volatile gint           bits;    ///< Latest written value (float bits)
+		volatile gint           dirty;   ///< 1 if written since last read
+		boost::weak_ptr<Port>   port;
+		float                   value;   ///< Latest value read
+		bool                    used;
+		bool                    pending; ///< Value not yet shown
+	};
+
+	typedef std::vector<Slot> Slots;
+
+	explicit ControlStream(size_t size) : _slots(size), _num_used(0) {}
+
+	/** Add a slot for @a port, returning its handle or -1 if full (GUI thread). */
+	int add(const boost::shared_ptr<Port>& port) {
+		for (size_t i = 0; i < _slots.size(); ++i) {
+			if (!_slots[i].used) {
+				_slots[i] = Slot();
+				_slots[i].port = port;
+				_slots[i].used = true;
+				++_num_used;
+				return int(i);
+			}
+		}
+		return -1;
+	}
+
+	/** Free the slot with @a handle (GUI thread). */
+	void remove(int handle) {
+		if (handle >= 0 && size_t(handle) < _slots.size() && _slots[handle].used) {
+			_slots[handle].used = false;
+			_slots[handle].port.reset();
+			--_num_used;
+		}
+	}
+
+	/** Set the latest value for @a handle (any thread). */
+	void write(int handle, float value) {
+		if (handle < 0 || size_t(handle) >= _slots.size())
+			return;
+
+		union { float f; gint i; } bits;
+		bits.f = value;
+
+		Slot& slot = _slots[handle];
+		g_atomic_int_set(&slot.bits, bits.i);
+		g_atomic_int_set(&slot.dirty, 1);
+	}
+
+	/** Return true if any value was written since it was last read (GUI thread). */
+	bool written() const {
+		for (Slots::const_iterator s = _slots.begin(); s != _slots.end(); ++s)
+			if (s->used && g_atomic_int_get(&s->dirty))
+				return true;
+		return false;
+	}
+
+	/** Move a newly written value into Slot::value, returning true if there was one. */
+	static bool read(Slot& slot) {
+		if (!g_atomic_int_compare_and_exchange(&slot.dirty, 1, 0))
+			return false;
+
+		union { float f; gint i; } bits;
+		bits.i     = g_atomic_int_get(&slot.bits);
+		slot.value = bits.f;
+		return true;
+	}
+
+	Slots& slots()          { return _slots; }
+	size_t num_used() const { return _num_used; }
+
+	size_t memory_bytes() const { return sizeof(ControlStream) + _slots.size() * sizeof(Slot); }
+
+private:
+	Slots  _slots;
+	size_t _num_used;
+};
+
+
+} // namespace FlowCanvas
+
+#endif // FLOWCANVAS_CONTROLSTREAM_HPP
@@ -0,0 +1,67 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+#ifndef FLOWCANVAS_DRAGANCHOR_HPP
+#define FLOWCANVAS_DRAGANCHOR_HPP
+
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include "flowcanvas/Connectable.hpp"
+#include "flowcanvas/Port.hpp"
+
+namespace FlowCanvas {
+
+
+/** Free end of a connection being dragged out of a port.
+ *
+ * Follows the pointer, or attaches exactly where a connection to the port
+ * it is snapped to would, without being a Module and Port on the canvas.
+ */
+class DragAnchor : public Connectable {
+public:
+	explicit DragAnchor(bool horizontal)
+		: _x(0.0), _y(0.0), _horizontal(horizontal) {}
+
+	void move_to(double x, double y) { _port.reset(); _x = x; _y = y; }
+	void snap_to(boost::shared_ptr<Port> port) { _port = port; }
+
+	Gnome::Art::Point src_connection_point() {
+		const boost::shared_ptr<Port> port = _port.lock();
+		return port ? port->src_connection_point() : Gnome::Art::Point(_x, _y);
+	}
+
+	Gnome::Art::Point dst_connection_point(const Gnome::Art::Point& src) {
+		return src_connection_point();
+	}
+
+	Gnome::Art::Point connection_point_vector(double dx, double dy) {
+		return _horizontal ? Gnome::Art::Point(dx, 0) : Gnome::Art::Point(0, dy);
+	}
+
+private:
+	boost::weak_ptr<Port> _port; ///< Port snapped to (if any)
+	double                _x;
+	double                _y;
+	bool                  _horizontal;
+};
+
+
+} // namespace FlowCanvas
+
+#endif // FLOWCANVAS_DRAGANCHOR_HPP
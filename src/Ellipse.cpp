@@ -26,6 +26,7 @@
 #include "flowcanvas/Canvas.hpp"
 #include "flowcanvas/Ellipse.hpp"
 #include "flowcanvas/Item.hpp"
+#include "MemoryAccounting.hpp"
 
 using std::string;
 
@@ -57,6 +58,7 @@ Ellipse::Ellipse(boost::shared_ptr<Canvas> canvas,
 	: Item(canvas, name, x, y, ELLIPSE_FILL_COLOUR)
 	, _title_visible(show_title)
 	, _ellipse(*this, -x_radius, -y_radius, x_radius, y_radius)
+	, _select_outline(NULL)
 	, _label(NULL)
 {
 	if (name != "")
@@ -90,6 +92,18 @@ Ellipse::Ellipse(boost::shared_ptr<Canvas> canvas,
 
 Ellipse::~Ellipse()
 {
+	delete _select_outline;
+}
+
+
+void
+Ellipse::account_memory(MemoryReport& report) const
+{
+	MemoryUsage& usage = report[MEM_ITEMS];
+	account_item_memory(usage, sizeof(Ellipse));
+	usage.object_bytes  += connections_heap_bytes();
+	usage.gobject_bytes += item_gobject_bytes(&_ellipse) + item_gobject_bytes(_select_outline);
+	account_text(usage, _label);
 }
 
 
@@ -133,6 +147,8 @@ Ellipse::set_border_width(double w)
 {
 	_border_width = w;
 	_ellipse.property_width_units() = w;
+	if (_select_outline)
+		_select_outline->property_width_units() = w;
 }
 
 
@@ -167,13 +183,22 @@ Ellipse::set_selected(bool selected)
 	if (!canvas)
 		return;
 
-	if (selected) {
-		_ellipse.property_outline_color_rgba() = ELLIPSE_HILITE_OUTLINE_COLOUR;
-		_ellipse.property_dash() = canvas->select_dash();
-	} else {
+	// Animated separately from the fill, see Module::set_selected
+	if (selected && !_select_outline) {
+		_ellipse.property_outline_color_rgba() = 0x00000000;
+		_select_outline = new Gnome::Canvas::Ellipse(*this,
+			_ellipse.property_x1(), _ellipse.property_y1(),
+			_ellipse.property_x2(), _ellipse.property_y2());
+		_select_outline->property_outline_color_rgba() = ELLIPSE_HILITE_OUTLINE_COLOUR;
+		_select_outline->property_width_units() = _border_width;
+		_select_outline->property_dash() = canvas->select_dash();
+		_select_outline->lower_to_bottom();
+		_select_outline->raise(1); // Just above _ellipse
+	} else if (!selected) {
+		delete _select_outline;
+		_select_outline = NULL;
 		_ellipse.property_fill_color_rgba() = _color;
 		_ellipse.property_outline_color_rgba() = ELLIPSE_OUTLINE_COLOUR;
-		_ellipse.property_dash() = NULL;
 	}
 }
 
@@ -216,6 +241,7 @@ void
 Ellipse::set_width(double w)
 {
 	_width = w;
+	update_bounds();
 //	_ellipse.property_x2() = _ellipse.property_x1() + w;
 }
 
@@ -224,6 +250,7 @@ void
 Ellipse::set_height(double h)
 {
 	_height = h;
+	update_bounds();
 //	_ellipse.property_y2() = _ellipse.property_y1() + h;
 }
 
@@ -254,6 +281,7 @@ Ellipse::move(double dx, double dy)
 		dy = canvas->height() - property_y() - _height;
 
 	Gnome::Canvas::Group::move(dx, dy);
+	update_bounds();
 
 	move_connections();
 }
@@ -287,6 +315,7 @@ Ellipse::move_to(double x, double y)
 	property_x() = x;
 	property_y() = y;
 	Gnome::Canvas::Group::move(0, 0);
+	update_bounds();
 
 	move_connections();
 }
@@ -397,15 +426,8 @@ Ellipse::resize()
 void
 Ellipse::select_tick()
 {
-	_ellipse.property_dash() = _canvas.lock()->select_dash();
-}
-
-
-void
-Ellipse::add_connection(boost::shared_ptr<Connection> c)
-{
-	Connectable::add_connection(c);
-	raise_to_top();
+	if (_select_outline)
+		_select_outline->property_dash() = _canvas.lock()->select_dash();
 }
 
 
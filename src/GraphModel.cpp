@@ -0,0 +1,650 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+
+#include "flowcanvas/GraphModel.hpp"
+#include "LayoutCache.hpp"
+#include "MemoryAccounting.hpp"
+
+namespace FlowCanvas {
+
+
+const uint32_t GraphModel::NONE;
+
+
+GraphModel::GraphModel()
+	: _num_items(0)
+	, _num_ports(0)
+	, _num_edges(0)
+	, _x1(DBL_MAX)
+	, _y1(DBL_MAX)
+	, _x2(-DBL_MAX)
+	, _y2(-DBL_MAX)
+	, _bounds_dirty(false)
+{
+}
+
+
+/** Remove everything, releasing all IDs. */
+void
+GraphModel::clear()
+{
+	_item_flags.clear();
+	_item_name.clear();
+	_item_x.clear();
+	_item_y.clear();
+	_item_w.clear();
+	_item_h.clear();
+	_item_partner.clear();
+	_item_ports.clear();
+	_item_edges.clear();
+	_free_items.clear();
+	_num_items = 0;
+
+	_port_flags.clear();
+	_port_item.clear();
+	_port_name.clear();
+	_port_x.clear();
+	_port_y.clear();
+	_port_w.clear();
+	_port_h.clear();
+	_free_ports.clear();
+	_num_ports = 0;
+
+	_edge_flags.clear();
+	_edge_tail_item.clear();
+	_edge_tail_port.clear();
+	_edge_head_item.clear();
+	_edge_head_port.clear();
+	_edge_length.clear();
+	_free_edges.clear();
+	_edge_index.clear();
+	_num_edges = 0;
+
+	_x1 = _y1 = DBL_MAX;
+	_x2 = _y2 = -DBL_MAX;
+	_bounds_dirty = false;
+}
+
+
+GraphModel::ItemID
+GraphModel::add_item(ItemKind kind, const Symbol& name,
+                     double x, double y, double w, double h)
+{
+	ItemID id;
+	if (!_free_items.empty()) {
+		id = _free_items.back();
+		_free_items.pop_back();
+	} else {
+		id = ItemID(_item_flags.size());
+		_item_flags.push_back(0);
+		_item_name.push_back(Symbol());
+		_item_x.push_back(0.0);
+		_item_y.push_back(0.0);
+		_item_w.push_back(0.0);
+		_item_h.push_back(0.0);
+		_item_partner.push_back(NONE);
+		_item_ports.push_back(std::vector<PortID>());
+		_item_edges.push_back(std::vector<EdgeID>());
+	}
+
+	_item_flags[id]   = ALIVE | (kind == MODULE ? IS_MODULE : 0);
+	_item_name[id]    = name;
+	_item_x[id]       = x;
+	_item_y[id]       = y;
+	_item_w[id]       = w;
+	_item_h[id]       = h;
+	_item_partner[id] = NONE;
+	++_num_items;
+
+	bounds_added(x, y, x + w, y + h);
+	return id;
+}
+
+
+/** Remove an item, along with its ports and all edges to/from it. */
+void
+GraphModel::remove_item(ItemID item)
+{
+	assert(item_valid(item));
+
+	while (!_item_edges[item].empty())
+		remove_edge(_item_edges[item].back());
+
+	while (!_item_ports[item].empty())
+		remove_port(_item_ports[item].back());
+
+	bounds_removed(_item_x[item], _item_y[item],
+	               _item_x[item] + _item_w[item], _item_y[item] + _item_h[item]);
+
+	_item_flags[item] = 0;
+	_item_name[item] = Symbol();
+	_item_partner[item] = NONE;
+	_free_items.push_back(item);
+	--_num_items;
+}
+
+
+void
+GraphModel::set_item_geometry(ItemID item, double x, double y, double w, double h)
+{
+	const double old_x1 = _item_x[item];
+	const double old_y1 = _item_y[item];
+	const double old_x2 = old_x1 + _item_w[item];
+	const double old_y2 = old_y1 + _item_h[item];
+
+	_item_x[item] = x;
+	_item_y[item] = y;
+	_item_w[item] = w;
+	_item_h[item] = h;
+
+	bounds_changed(old_x1, old_y1, old_x2, old_y2, x, y, x + w, y + h);
+}
+
+
+GraphModel::PortID
+GraphModel::add_port(ItemID item, const Symbol& name, bool is_input)
+{
+	assert(item_valid(item));
+
+	PortID id;
+	if (!_free_ports.empty()) {
+		id = _free_ports.back();
+		_free_ports.pop_back();
+	} else {
+		id = PortID(_port_flags.size());
+		_port_flags.push_back(0);
+		_port_item.push_back(NONE);
+		_port_name.push_back(Symbol());
+		_port_x.push_back(0.0);
+		_port_y.push_back(0.0);
+		_port_w.push_back(0.0);
+		_port_h.push_back(0.0);
+	}
+
+	_port_flags[id] = ALIVE | (is_input ? IS_INPUT : 0);
+	_port_item[id]  = item;
+	_port_name[id]  = name;
+	_port_x[id] = _port_y[id] = _port_w[id] = _port_h[id] = 0.0;
+	_item_ports[item].push_back(id);
+	++_num_ports;
+
+	return id;
+}
+
+
+/** Remove a port, along with all edges to/from it. */
+void
+GraphModel::remove_port(PortID port)
+{
+	assert(port_valid(port));
+
+	std::vector<EdgeID> edges;
+	port_edges(port, edges);
+	for (std::vector<EdgeID>::const_iterator e = edges.begin(); e != edges.end(); ++e)
+		remove_edge(*e);
+
+	std::vector<PortID>& ports = _item_ports[_port_item[port]];
+	ports.erase(std::find(ports.begin(), ports.end(), port));
+
+	_port_flags[port] = 0;
+	_port_item[port]  = NONE;
+	_port_name[port] = Symbol();
+	_free_ports.push_back(port);
+	--_num_ports;
+}
+
+
+void
+GraphModel::set_port_geometry(PortID port, double x, double y, double w, double h)
+{
+	_port_x[port] = x;
+	_port_y[port] = y;
+	_port_w[port] = w;
+	_port_h[port] = h;
+}
+
+
+GraphModel::PortID
+GraphModel::find_port(ItemID item, const std::string& name) const
+{
+	// No port can have a name that is not interned
+	const Symbol symbol = Symbol::find(name);
+	if (symbol.empty() && !name.empty())
+		return NONE;
+
+	const std::vector<PortID>& ports = _item_ports[item];
+	for (std::vector<PortID>::const_iterator p = ports.begin(); p != ports.end(); ++p)
+		if (_port_name[*p] == symbol)
+			return *p;
+
+	return NONE;
+}
+
+
+/** Return the port at world coordinate @a x, @a y, or NONE.
+ *
+ * Only ports on the first module containing the point are considered.
+ */
+GraphModel::PortID
+GraphModel::port_at(double x, double y) const
+{
+	for (ItemID i = 0; i < _item_flags.size(); ++i) {
+		if ((_item_flags[i] & (ALIVE|IS_MODULE)) != (ALIVE|IS_MODULE))
+			continue;
+
+		if (x > _item_x[i] && x < _item_x[i] + _item_w[i]
+				&& y > _item_y[i] && y < _item_y[i] + _item_h[i]) {
+			const double px = x - _item_x[i];
+			const double py = y - _item_y[i];
+			const std::vector<PortID>& ports = _item_ports[i];
+			for (std::vector<PortID>::const_iterator p = ports.begin(); p != ports.end(); ++p)
+				if (px > _port_x[*p] && px < _port_x[*p] + _port_w[*p]
+						&& py > _port_y[*p] && py < _port_y[*p] + _port_h[*p])
+					return *p;
+
+			return NONE;
+		}
+	}
+
+	return NONE;
+}
+
+
+/** Append all edges to/from @a port to @a edges. */
+void
+GraphModel::port_edges(PortID port, std::vector<EdgeID>& edges) const
+{
+	const std::vector<EdgeID>& item_edges = _item_edges[_port_item[port]];
+	for (std::vector<EdgeID>::const_iterator e = item_edges.begin(); e != item_edges.end(); ++e)
+		if (_edge_tail_port[*e] == port || _edge_head_port[*e] == port)
+			if (std::find(edges.begin(), edges.end(), *e) == edges.end())
+				edges.push_back(*e);
+}
+
+
+GraphModel::EdgeID
+GraphModel::add_edge(ItemID tail_item, PortID tail_port, ItemID head_item, PortID head_port)
+{
+	assert(item_valid(tail_item) && item_valid(head_item));
+
+	EdgeID id;
+	if (!_free_edges.empty()) {
+		id = _free_edges.back();
+		_free_edges.pop_back();
+	} else {
+		id = EdgeID(_edge_flags.size());
+		_edge_flags.push_back(0);
+		_edge_tail_item.push_back(NONE);
+		_edge_tail_port.push_back(NONE);
+		_edge_head_item.push_back(NONE);
+		_edge_head_port.push_back(NONE);
+		_edge_length.push_back(0.0);
+	}
+
+	_edge_flags[id]     = ALIVE;
+	_edge_tail_item[id] = tail_item;
+	_edge_tail_port[id] = tail_port;
+	_edge_head_item[id] = head_item;
+	_edge_head_port[id] = head_port;
+	_edge_length[id]    = 0.0;
+
+	_item_edges[tail_item].push_back(id);
+	if (head_item != tail_item)
+		_item_edges[head_item].push_back(id);
+
+	_edge_index[EdgeKey(endpoint_key(tail_item, tail_port),
+	                    endpoint_key(head_item, head_port))] = id;
+	++_num_edges;
+
+	return id;
+}
+
+
+void
+GraphModel::remove_edge(EdgeID edge)
+{
+	assert(edge_valid(edge));
+
+	const ItemID tail_item = _edge_tail_item[edge];
+	const ItemID head_item = _edge_head_item[edge];
+
+	const EdgeKey key(endpoint_key(tail_item, _edge_tail_port[edge]),
+	                  endpoint_key(head_item, _edge_head_port[edge]));
+	std::map<EdgeKey, EdgeID>::iterator i = _edge_index.find(key);
+	if (i != _edge_index.end() && i->second == edge)
+		_edge_index.erase(i);
+
+	edge_list_remove(_item_edges[tail_item], edge);
+	if (head_item != tail_item)
+		edge_list_remove(_item_edges[head_item], edge);
+
+	_edge_flags[edge] = 0;
+	_edge_tail_item[edge] = _edge_head_item[edge] = NONE;
+	_edge_tail_port[edge] = _edge_head_port[edge] = NONE;
+	_free_edges.push_back(edge);
+	--_num_edges;
+}
+
+
+GraphModel::EdgeID
+GraphModel::find_edge(ItemID tail_item, PortID tail_port, ItemID head_item, PortID head_port) const
+{
+	std::map<EdgeKey, EdgeID>::const_iterator i = _edge_index.find(
+		EdgeKey(endpoint_key(tail_item, tail_port), endpoint_key(head_item, head_port)));
+
+	return (i != _edge_index.end()) ? i->second : NONE;
+}
+
+
+void
+GraphModel::edge_list_remove(std::vector<EdgeID>& edges, EdgeID edge)
+{
+	std::vector<EdgeID>::iterator i = std::find(edges.begin(), edges.end(), edge);
+	if (i != edges.end()) {
+		*i = edges.back();
+		edges.pop_back();
+	}
+}
+
+
+/** Select an item, and any edges between it and other selected items.
+ *
+ * Edges that became selected are appended to @a selected_edges.
+ */
+void
+GraphModel::select_item(ItemID item, std::vector<EdgeID>& selected_edges)
+{
+	_item_flags[item] |= SELECTED;
+
+	const std::vector<EdgeID>& edges = _item_edges[item];
+	for (std::vector<EdgeID>::const_iterator e = edges.begin(); e != edges.end(); ++e) {
+		if (_edge_flags[*e] & SELECTED)
+			continue;
+
+		const ItemID other = (_edge_tail_item[*e] == item)
+			? _edge_head_item[*e] : _edge_tail_item[*e];
+
+		if (_item_flags[other] & SELECTED) {
+			_edge_flags[*e] |= SELECTED;
+			selected_edges.push_back(*e);
+		}
+	}
+}
+
+
+/** Unselect an item, and any selected edges to/from it.
+ *
+ * Edges that became unselected are appended to @a unselected_edges.
+ */
+void
+GraphModel::unselect_item(ItemID item, std::vector<EdgeID>& unselected_edges)
+{
+	_item_flags[item] &= ~SELECTED;
+
+	const std::vector<EdgeID>& edges = _item_edges[item];
+	for (std::vector<EdgeID>::const_iterator e = edges.begin(); e != edges.end(); ++e) {
+		if (_edge_flags[*e] & SELECTED) {
+			_edge_flags[*e] &= ~SELECTED;
+			unselected_edges.push_back(*e);
+		}
+	}
+}
+
+
+void
+GraphModel::set_edge_selected(EdgeID edge, bool selected)
+{
+	if (selected)
+		_edge_flags[edge] |= SELECTED;
+	else
+		_edge_flags[edge] &= ~SELECTED;
+}
+
+
+void
+GraphModel::clear_selection()
+{
+	for (std::vector<uint8_t>::iterator f = _item_flags.begin(); f != _item_flags.end(); ++f)
+		*f &= ~SELECTED;
+
+	for (std::vector<uint8_t>::iterator f = _edge_flags.begin(); f != _edge_flags.end(); ++f)
+		*f &= ~SELECTED;
+}
+
+
+/** Append all items entirely inside the given rectangle to @a items.
+ *
+ * The corners may be given in any order.
+ */
+void
+GraphModel::items_within(double x1, double y1, double x2, double y2,
+                         std::vector<ItemID>& items) const
+{
+	if (x2 < x1)
+		std::swap(x1, x2);
+	if (y2 < y1)
+		std::swap(y1, y2);
+
+	for (ItemID i = 0; i < _item_flags.size(); ++i)
+		if ((_item_flags[i] & ALIVE)
+				&& _item_x[i] > x1 && _item_y[i] > y1
+				&& _item_x[i] + _item_w[i] < x2 && _item_y[i] + _item_h[i] < y2)
+			items.push_back(i);
+}
+
+
+/** Return the number of items at least partially inside the given rectangle. */
+size_t
+GraphModel::count_items_intersecting(double x1, double y1, double x2, double y2) const
+{
+	size_t count = 0;
+	for (ItemID i = 0; i < _item_flags.size(); ++i)
+		if ((_item_flags[i] & ALIVE)
+				&& _item_x[i] < x2 && _item_y[i] < y2
+				&& _item_x[i] + _item_w[i] > x1 && _item_y[i] + _item_h[i] > y1)
+			++count;
+
+	return count;
+}
+
+
+size_t
+GraphModel::memory_bytes() const
+{
+	size_t bytes = sizeof(GraphModel)
+		+ vector_heap_bytes(_item_flags) + vector_heap_bytes(_item_name)
+		+ vector_heap_bytes(_item_x) + vector_heap_bytes(_item_y)
+		+ vector_heap_bytes(_item_w) + vector_heap_bytes(_item_h)
+		+ vector_heap_bytes(_item_partner) + vector_heap_bytes(_item_ports)
+		+ vector_heap_bytes(_item_edges) + vector_heap_bytes(_free_items)
+		+ vector_heap_bytes(_port_flags) + vector_heap_bytes(_port_item)
+		+ vector_heap_bytes(_port_name)
+		+ vector_heap_bytes(_port_x) + vector_heap_bytes(_port_y)
+		+ vector_heap_bytes(_port_w) + vector_heap_bytes(_port_h)
+		+ vector_heap_bytes(_free_ports)
+		+ vector_heap_bytes(_edge_flags)
+		+ vector_heap_bytes(_edge_tail_item) + vector_heap_bytes(_edge_tail_port)
+		+ vector_heap_bytes(_edge_head_item) + vector_heap_bytes(_edge_head_port)
+		+ vector_heap_bytes(_edge_length) + vector_heap_bytes(_free_edges)
+		+ map_heap_bytes(_edge_index);
+
+	for (size_t i = 0; i < _item_name.size(); ++i)
+		bytes += vector_heap_bytes(_item_ports[i]) + vector_heap_bytes(_item_edges[i]);
+
+	return bytes;
+}
+
+
+/** Get the bounding box of all items.
+ *
+ * The box is maintained incrementally as items move and resize, and only
+ * recalculated from scratch when an item on its edge moves inwards or is
+ * removed.  Returns false if there are no items.
+ */
+bool
+GraphModel::get_bounds(double& x1, double& y1, double& x2, double& y2)
+{
+	if (_bounds_dirty) {
+		_x1 = _y1 = DBL_MAX;
+		_x2 = _y2 = -DBL_MAX;
+		for (ItemID i = 0; i < _item_flags.size(); ++i) {
+			if (_item_flags[i] & ALIVE) {
+				_x1 = std::min(_x1, _item_x[i]);
+				_y1 = std::min(_y1, _item_y[i]);
+				_x2 = std::max(_x2, _item_x[i] + _item_w[i]);
+				_y2 = std::max(_y2, _item_y[i] + _item_h[i]);
+			}
+		}
+		_bounds_dirty = false;
+	}
+
+	x1 = _x1;
+	y1 = _y1;
+	x2 = _x2;
+	y2 = _y2;
+	return x1 <= x2;
+}
+
+
+void
+GraphModel::bounds_changed(double old_x1, double old_y1, double old_x2, double old_y2,
+                           double x1, double y1, double x2, double y2)
+{
+	if (_bounds_dirty)
+		return;
+
+	if ((old_x1 <= _x1 && x1 > old_x1) || (old_y1 <= _y1 && y1 > old_y1)
+			|| (old_x2 >= _x2 && x2 < old_x2) || (old_y2 >= _y2 && y2 < old_y2)) {
+		// An item on the edge moved inwards, the box may have shrunk
+		_bounds_dirty = true;
+	} else {
+		bounds_added(x1, y1, x2, y2);
+	}
+}
+
+
+void
+GraphModel::bounds_added(double x1, double y1, double x2, double y2)
+{
+	_x1 = std::min(_x1, x1);
+	_y1 = std::min(_y1, y1);
+	_x2 = std::max(_x2, x2);
+	_y2 = std::max(_y2, y2);
+}
+
+
+void
+GraphModel::bounds_removed(double x1, double y1, double x2, double y2)
+{
+	if (x1 <= _x1 || y1 <= _y1 || x2 >= _x2 || y2 >= _y2)
+		_bounds_dirty = true;
+}
+
+
+struct LayoutOrder {
+	explicit LayoutOrder(const GraphModel& m) : model(m) {}
+
+	inline bool operator()(GraphModel::ItemID a, GraphModel::ItemID b) const {
+		if (model.item_symbol(a) != model.item_symbol(b))
+			return model.item_symbol(a) < model.item_symbol(b);
+		else if (model.item_w(a) != model.item_w(b))
+			return model.item_w(a) < model.item_w(b);
+		else
+			return model.item_h(a) < model.item_h(b);
+	}
+
+	const GraphModel& model;
+};
+
+
+/** Get all items in a canonical order for layout.
+ *
+ * The order depends only on item names and sizes (not on the order items
+ * were added), so the same graph always produces the same layout and key.
+ */
+void
+GraphModel::layout_order(std::vector<ItemID>& items) const
+{
+	items.clear();
+	items.reserve(_num_items);
+	for (ItemID i = 0; i < _item_flags.size(); ++i)
+		if (_item_flags[i] & ALIVE)
+			items.push_back(i);
+
+	std::stable_sort(items.begin(), items.end(), LayoutOrder(*this));
+}
+
+
+/** Return a hash of everything that affects the layout of @a items.
+ *
+ * This covers the topology, item sizes, flow @a direction and edge length
+ * hints, but not the current item positions.
+ */
+uint64_t
+GraphModel::layout_key(const std::vector<ItemID>& items, uint32_t direction) const
+{
+	LayoutHash hash;
+	hash.add(direction);
+	hash.add(uint32_t(items.size()));
+
+	std::vector<uint32_t> index(_item_flags.size(), NONE);
+	for (size_t i = 0; i < items.size(); ++i) {
+		const ItemID item = items[i];
+		index[item] = uint32_t(i);
+		hash.add(uint32_t((_item_flags[item] & IS_MODULE) ? 1 : 0));
+		hash.add(_item_name[item].str());
+		hash.add(_item_w[item]);
+		hash.add(_item_h[item]);
+	}
+
+	typedef std::pair< std::pair<uint32_t, uint32_t>, double > LayoutEdge;
+	std::vector<LayoutEdge> edges;
+	edges.reserve(_num_edges);
+	for (EdgeID e = 0; e < _edge_flags.size(); ++e) {
+		if (!(_edge_flags[e] & ALIVE))
+			continue;
+
+		const uint32_t s = index[_edge_tail_item[e]];
+		const uint32_t d = index[_edge_head_item[e]];
+		if (s != NONE && d != NONE)
+			edges.push_back(std::make_pair(std::make_pair(s, d), _edge_length[e]));
+	}
+
+	// Partners are laid out as if connected, mark them with a negative length
+	for (size_t i = 0; i < items.size(); ++i) {
+		const ItemID partner = _item_partner[items[i]];
+		if (partner != NONE && index[partner] != NONE)
+			edges.push_back(std::make_pair(std::make_pair(uint32_t(i), index[partner]), -1.0));
+	}
+
+	std::sort(edges.begin(), edges.end());
+	hash.add(uint32_t(edges.size()));
+	for (std::vector<LayoutEdge>::const_iterator e = edges.begin(); e != edges.end(); ++e) {
+		hash.add(e->first.first);
+		hash.add(e->first.second);
+		hash.add(e->second);
+	}
+
+	return hash.value();
+}
+
+
+} // namespace FlowCanvas
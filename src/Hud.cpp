@@ -0,0 +1,227 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <algorithm>
+#include <cstdio>
+
+#include <glib.h>
+
+#include "flowcanvas/Canvas.hpp"
+#include "Clock.hpp"
+#include "Hud.hpp"
+
+namespace FlowCanvas {
+
+static const uint64_t HUD_WINDOW_US   = 1000000; ///< Rolling window length
+static const unsigned HUD_UPDATE_MS   = 500;
+static const double   HUD_MARGIN      = 8.0;
+static const uint32_t HUD_BACKGROUND  = 0x000000C0;
+static const uint32_t HUD_TEXT_COLOUR = 0xC0E0C0FF;
+
+
+Hud::Hud(Canvas& canvas)
+	: _canvas(canvas)
+	, _group(*canvas.layer(Canvas::LAYER_OVERLAY), 0, 0)
+	, _background(_group, 0, 0, 1, 1)
+	, _text(_group, 4, 4, "")
+	, _input_time(0)
+	, _last_reroutes(canvas.operation_stats(OP_UPDATE_CONNECTION).count)
+	, _frames(0)
+	, _last_frames(0)
+	, _redrawn(false)
+{
+	_background.property_fill_color_rgba()    = HUD_BACKGROUND;
+	_background.property_outline_color_rgba() = 0;
+
+	_text.property_family()          = "Monospace";
+	_text.property_size_set()        = true;
+	_text.property_size()            = 8000;
+	_text.property_anchor()          = Gtk::ANCHOR_NW;
+	_text.property_fill_color_rgba() = HUD_TEXT_COLOUR;
+
+	update();
+	_update_connection = Glib::signal_timeout().connect(
+		sigc::mem_fun(this, &Hud::update), HUD_UPDATE_MS);
+}
+
+
+Hud::~Hud()
+{
+	_update_connection.disconnect();
+}
+
+
+uint64_t
+Hud::now_us()
+{
+	return monotonic_us();
+}
+
+
+/** Note that an input event arrived, to measure how long until it is shown. */
+void
+Hud::input_received()
+{
+	if (!_input_time)
+		_input_time = now_us();
+}
+
+
+/** Return true if @a area (in window coordinates) was only redrawn for the
+ * HUD's own update, which is not a frame of the canvas.
+ */
+bool
+Hud::own_repaint(const GdkRectangle& area) const
+{
+	int scroll_x, scroll_y;
+	_canvas.get_scroll_offsets(scroll_x, scroll_y);
+
+	const int x = area.x + scroll_x;
+	const int y = area.y + scroll_y;
+	return x >= _dirty.x1 && y >= _dirty.y1
+		&& x + area.width <= _dirty.x2 && y + area.height <= _dirty.y2;
+}
+
+
+/** Note that @a area of the window was painted from @a start_us to @a end_us. */
+void
+Hud::frame_painted(const GdkRectangle& area, uint64_t start_us, uint64_t end_us)
+{
+	const bool own = _redrawn && own_repaint(area);
+	_redrawn = false;
+	if (own)
+		return;
+
+	// Ignore input that was long ago, it probably didn't cause this frame
+	const int64_t latency = (_input_time && end_us - _input_time < HUD_WINDOW_US)
+		? int64_t(end_us - _input_time) : -1;
+	_input_time = 0;
+	++_frames;
+
+	_samples.push_back(Sample(end_us, uint32_t(end_us - start_us), latency));
+	while (!_samples.empty() && _samples.front().time + HUD_WINDOW_US < end_us)
+		_samples.pop_front();
+}
+
+
+/** Refresh the displayed figures and move the display to the visible corner. */
+bool
+Hud::update()
+{
+	const uint64_t now = now_us();
+	while (!_samples.empty() && _samples.front().time + HUD_WINDOW_US < now)
+		_samples.pop_front();
+
+	double   repaint_total = 0.0, latency_total = 0.0;
+	uint32_t repaint_max   = 0;
+	int64_t  latency_max   = 0;
+	unsigned n_latencies   = 0;
+	for (std::deque<Sample>::const_iterator s = _samples.begin(); s != _samples.end(); ++s) {
+		repaint_total += s->repaint_us;
+		repaint_max = std::max(repaint_max, s->repaint_us);
+		if (s->latency_us >= 0) {
+			latency_total += s->latency_us;
+			latency_max = std::max(latency_max, s->latency_us);
+			++n_latencies;
+		}
+	}
+
+	const size_t n_frames = _samples.size();
+	const double fps      = n_frames * 1000000.0 / HUD_WINDOW_US;
+
+	// Visible region in world coordinates
+	int scroll_x, scroll_y, win_width = 0, win_height = 0;
+	_canvas.get_scroll_offsets(scroll_x, scroll_y);
+	Glib::RefPtr<Gdk::Window> win = _canvas.get_window();
+	if (win)
+		win->get_size(win_width, win_height);
+
+	double x1, y1, x2, y2;
+	_canvas.c2w(scroll_x, scroll_y, x1, y1);
+	_canvas.c2w(scroll_x + win_width, scroll_y + win_height, x2, y2);
+
+	const GraphModel& model = _canvas.model();
+
+	char text[512];
+	int  len = snprintf(text, sizeof(text),
+		"repaint  %6.2f ms avg %6.2f ms max\n"
+		"latency  %6.2f ms avg %6.2f ms max\n"
+		"fps      %6.1f\n"
+		"items    %6lu visible %6lu total\n"
+		"conns    %6lu\n",
+		n_frames ? repaint_total / n_frames / 1000.0 : 0.0, repaint_max / 1000.0,
+		n_latencies ? latency_total / n_latencies / 1000.0 : 0.0, latency_max / 1000.0,
+		fps,
+		(unsigned long)model.count_items_intersecting(x1, y1, x2, y2),
+		(unsigned long)model.num_items(),
+		(unsigned long)model.num_edges());
+
+	if (Canvas::instrumented()) {
+		const uint64_t reroutes = _canvas.operation_stats(OP_UPDATE_CONNECTION).count;
+		const uint64_t frames   = _frames - _last_frames;
+		snprintf(text + len, sizeof(text) - len, "reroutes %6.1f / frame",
+		         frames ? double(reroutes - _last_reroutes) / frames : 0.0);
+		_last_reroutes = reroutes;
+	} else {
+		snprintf(text + len, sizeof(text) - len, "reroutes    n/a (not instrumented)");
+	}
+	_last_frames = _frames;
+
+	_text.property_text() = text;
+	place();
+
+	return true;
+}
+
+
+/** Move the display to the visible corner, at the same size on screen at any zoom.
+ *
+ * Text is not scaled by the canvas, so everything else is scaled by 1/zoom
+ * to match it.
+ */
+void
+Hud::place()
+{
+	int scroll_x, scroll_y;
+	_canvas.get_scroll_offsets(scroll_x, scroll_y);
+
+	double x, y;
+	_canvas.c2w(scroll_x, scroll_y, x, y);
+
+	const double zoom = _canvas.get_zoom();
+	_group.property_x() = x + HUD_MARGIN / zoom;
+	_group.property_y() = y + HUD_MARGIN / zoom;
+	_group.move(0, 0);
+	_text.property_x() = 4.0 / zoom;
+	_text.property_y() = 4.0 / zoom;
+	_background.property_x2() = _text.property_text_width() + 8.0 / zoom;
+	_background.property_y2() = _text.property_text_height() + 8.0 / zoom;
+
+	// Both the old and new area are redrawn, see own_repaint()
+	const Area old = _redrawn ? _dirty : _shown;
+	_canvas.w2c(_group.property_x(), _group.property_y(), _shown.x1, _shown.y1);
+	_canvas.w2c(_group.property_x() + _background.property_x2(),
+	            _group.property_y() + _background.property_y2(), _shown.x2, _shown.y2);
+	_dirty.x1 = std::min(old.x1, _shown.x1 - 1);
+	_dirty.y1 = std::min(old.y1, _shown.y1 - 1);
+	_dirty.x2 = std::max(old.x2, _shown.x2 + 1);
+	_dirty.y2 = std::max(old.y2, _shown.y2 + 1);
+	_redrawn = true;
+}
+
+
+} // namespace FlowCanvas
@@ -0,0 +1,85 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef FLOWCANVAS_HUD_HPP
+#define FLOWCANVAS_HUD_HPP
+
+#include <stdint.h>
+
+#include <deque>
+
+#include <libgnomecanvasmm.h>
+
+namespace FlowCanvas {
+
+class Canvas;
+
+
+/** Heads-up display of canvas performance, drawn over the canvas contents.
+ *
+ * Shows repaint time, input to paint latency and frame rate over a rolling
+ * window, item and connection counts, and (if instrumented) connection
+ * reroutes per frame.
+ */
+class Hud {
+public:
+	explicit Hud(Canvas& canvas);
+	~Hud();
+
+	static uint64_t now_us();
+
+	void input_received();
+	void frame_painted(const GdkRectangle& area, uint64_t start_us, uint64_t end_us);
+	void place();
+
+private:
+	bool update();
+	bool own_repaint(const GdkRectangle& area) const;
+
+	/** Rectangle in canvas pixels. */
+	struct Area {
+		Area() : x1(0), y1(0), x2(0), y2(0) {}
+		int x1, y1, x2, y2;
+	};
+
+	struct Sample {
+		Sample(uint64_t t, uint32_t r, int64_t l) : time(t), repaint_us(r), latency_us(l) {}
+
+		uint64_t time;       ///< End of paint
+		uint32_t repaint_us;
+		int64_t  latency_us; ///< -1 if frame was not caused by input
+	};
+
+	Canvas&              _canvas;
+	Gnome::Canvas::Group _group;
+	Gnome::Canvas::Rect  _background;
+	Gnome::Canvas::Text  _text;
+	sigc::connection     _update_connection;
+	std::deque<Sample>   _samples;
+	uint64_t             _input_time;     ///< First unpainted input, or 0
+	uint64_t             _last_reroutes;  ///< Reroute count at last update
+	uint64_t             _frames;         ///< Total painted frames
+	uint64_t             _last_frames;    ///< _frames at last update
+	Area                 _shown;          ///< Where the display is now
+	Area                 _dirty;          ///< Where it changed since the last frame
+	bool                 _redrawn;        ///< Changed since the last frame
+};
+
+
+} // namespace FlowCanvas
+
+#endif // FLOWCANVAS_HUD_HPP
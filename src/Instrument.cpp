@@ -0,0 +1,55 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include "flowcanvas/Instrument.hpp"
+
+namespace FlowCanvas {
+
+
+const char*
+operation_name(Operation op)
+{
+	switch (op) {
+	case OP_ADD_ITEM:          return "add_item";
+	case OP_REMOVE_ITEM:       return "remove_item";
+	case OP_ADD_CONNECTION:    return "add_connection";
+	case OP_REMOVE_CONNECTION: return "remove_connection";
+	case OP_SELECT_ITEM:       return "select_item";
+	case OP_UNSELECT_ITEM:     return "unselect_item";
+	case OP_CLEAR_SELECTION:   return "clear_selection";
+	case OP_GET_PORT_AT:       return "get_port_at";
+	case OP_MOVE_ITEMS:        return "move_items";
+	case OP_UPDATE_CONNECTION: return "update_connection";
+	case OP_RESIZE_MODULE:     return "resize_module";
+	case OP_MEASURE_TEXT:      return "measure_text";
+	case OP_SET_ZOOM:          return "set_zoom";
+	case OP_ARRANGE:           return "arrange";
+	case OP_LAYOUT:            return "layout";
+	case OP_FRAME:             return "frame";
+	case OP_REPAINT:           return "repaint";
+	case OP_CANVAS_EVENT:      return "canvas_event";
+	case OP_PORT_EVENT:        return "port_event";
+	case OP_ITEM_EVENT:        return "item_event";
+	case OP_SYNC:              return "sync";
+	case OP_COMMANDS:          return "commands";
+	case N_OPERATIONS:         break;
+	}
+	return "unknown";
+}
+
+
+} // namespace FlowCanvas
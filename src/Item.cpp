@@ -22,6 +22,8 @@
 
 #include "flowcanvas/Canvas.hpp"
 #include "flowcanvas/Item.hpp"
+#include "MemoryAccounting.hpp"
+#include "ScopedOperation.hpp"
 
 using std::string;
 using std::list;
@@ -34,7 +36,7 @@ Item::Item(boost::shared_ptr<Canvas> canvas,
            double                    x,
            double                    y,
            uint32_t                  color)
-	: Gnome::Canvas::Group(*canvas->root(), x, y)
+	: Gnome::Canvas::Group(*canvas->layer(Canvas::LAYER_ITEMS), x, y)
 	, _canvas(canvas)
 	, _menu(NULL)
 	, _name(name)
@@ -43,11 +45,65 @@ Item::Item(boost::shared_ptr<Canvas> canvas,
 	, _height(1.0)
 	, _border_color(color)
 	, _color(color)
+	, _model_id(GraphModel::NONE)
 	, _selected(false)
 {
 }
 
 
+/** Tell the canvas this item's position or size may have changed.
+ *
+ * This must be called after changing the position or size of an item
+ * directly (e.g. via property_x()), so the canvas model stays correct.
+ * Item implementations call this themselves when moved or resized.
+ */
+void
+Item::update_bounds()
+{
+	if (_model_id == GraphModel::NONE)
+		return;
+
+	boost::shared_ptr<Canvas> canvas = _canvas.lock();
+	if (canvas)
+		canvas->_model.set_item_geometry(_model_id, property_x(), property_y(),
+		                                 _width, _height);
+}
+
+
+/** Tell the canvas this item's name has changed. */
+void
+Item::name_changed()
+{
+	if (_model_id == GraphModel::NONE)
+		return;
+
+	boost::shared_ptr<Canvas> canvas = _canvas.lock();
+	if (canvas)
+		canvas->_model.set_item_name(_model_id, _name);
+}
+
+
+void
+Item::account_memory(MemoryReport& report) const
+{
+	account_item_memory(report[MEM_ITEMS], sizeof(Item));
+}
+
+
+/** Add the memory used by the Item part of this object to @a usage.
+ * @param object_bytes Size of the most derived object.
+ */
+void
+Item::account_item_memory(MemoryUsage& usage, size_t object_bytes) const
+{
+	++usage.count;
+	usage.object_bytes  += object_bytes + SHARED_COUNT_BYTES;
+	usage.gobject_bytes += group_gobject_bytes(*this);
+	if (_menu)
+		usage.gobject_bytes += gobject_bytes(_menu->gobj());
+}
+
+
 void
 Item::set_selected(bool s)
 {
@@ -69,6 +125,8 @@ Item::on_event(GdkEvent* event)
 	if (!canvas || !event)
 		return false;
 
+	FLOWCANVAS_INSTRUMENT_SCOPE(canvas.get(), OP_ITEM_EVENT);
+
 	static double x, y;
 	static double drag_start_x, drag_start_y;
 	static bool double_click = false;
@@ -119,7 +177,8 @@ Item::on_event(GdkEvent* event)
 				new_y = t_y;
 			}
 
-			on_drag(new_x - x, new_y - y);
+			// Moved by drag_by() on the next frame
+			canvas->defer_drag(shared_from_this(), new_x - x, new_y - y);
 
 			x = new_x;
 			y = new_y;
@@ -130,6 +189,7 @@ Item::on_event(GdkEvent* event)
 		if (dragging) {
 			ungrab(event->button.time);
 			dragging = false;
+			canvas->flush_motion();
 			if (click_x != drag_start_x || click_y != drag_start_y) {
 				on_drop();
 			} else if (!double_click) {
@@ -0,0 +1,205 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <locale>
+#include <sstream>
+
+#include "LayoutCache.hpp"
+#include "MemoryAccounting.hpp"
+
+using std::cerr;
+using std::endl;
+using std::string;
+
+namespace FlowCanvas {
+
+static const char* const LAYOUT_CACHE_MAGIC = "flowcanvas-layout-cache-1";
+
+
+LayoutCache::LayoutCache(size_t max_entries)
+	: _max_entries(max_entries)
+	, _loaded(true)
+{
+}
+
+
+/** Set the file used to persist cached layouts.
+ *
+ * The file is read lazily on the next lookup.  Passing the empty string
+ * disables the on-disk cache (the in-memory cache is kept).
+ */
+void
+LayoutCache::set_filename(const string& filename)
+{
+	if (filename != _filename) {
+		_filename = filename;
+		_loaded   = _filename.empty();
+	}
+}
+
+
+/** Find a cached layout for @a key.
+ *
+ * Returns true and sets @a positions if a layout with @a n_nodes positions
+ * is cached under @a key.
+ */
+bool
+LayoutCache::find(uint64_t key, size_t n_nodes, Positions& positions)
+{
+	if (!_loaded)
+		load();
+
+	Entries::const_iterator i = _entries.find(key);
+	if (i == _entries.end() || i->second.size() != n_nodes)
+		return false;
+
+	_order.remove(key);
+	_order.push_back(key);
+	positions = i->second;
+	return true;
+}
+
+
+void
+LayoutCache::insert(uint64_t key, const Positions& positions)
+{
+	if (!_loaded)
+		load();
+
+	_order.remove(key);
+	_order.push_back(key);
+	_entries[key] = positions;
+	evict();
+
+	if (!_filename.empty())
+		save();
+}
+
+
+void
+LayoutCache::clear()
+{
+	_entries.clear();
+	_order.clear();
+	if (!_filename.empty())
+		std::remove(_filename.c_str());
+}
+
+
+size_t
+LayoutCache::memory_bytes() const
+{
+	size_t bytes = sizeof(LayoutCache) + map_heap_bytes(_entries)
+		+ list_heap_bytes(_order) + string_heap_bytes(_filename);
+	for (Entries::const_iterator e = _entries.begin(); e != _entries.end(); ++e)
+		bytes += vector_heap_bytes(e->second);
+	return bytes;
+}
+
+
+void
+LayoutCache::evict()
+{
+	while (_entries.size() > _max_entries) {
+		_entries.erase(_order.front());
+		_order.pop_front();
+	}
+}
+
+
+/** Read cached layouts from the cache file.
+ *
+ * The format is a magic line followed by one line per entry:
+ * "<key> <n> <x1> <y1> ... <xn> <yn>", least recently used first.
+ * Numbers are always in the "C" locale.
+ */
+void
+LayoutCache::load()
+{
+	_loaded = true;
+
+	std::ifstream is(_filename.c_str());
+	if (!is.good())
+		return;
+
+	is.imbue(std::locale::classic());
+
+	string line;
+	if (!std::getline(is, line) || line != LAYOUT_CACHE_MAGIC) {
+		cerr << "Ignoring invalid layout cache " << _filename << endl;
+		return;
+	}
+
+	while (std::getline(is, line)) {
+		std::istringstream ss(line);
+		ss.imbue(std::locale::classic());
+
+		uint64_t key = 0;
+		size_t   n   = 0;
+		if (!(ss >> std::hex >> key >> std::dec >> n))
+			continue;
+
+		Positions positions(n);
+		for (size_t i = 0; i < n && ss; ++i)
+			ss >> positions[i].first >> positions[i].second;
+
+		if (ss) {
+			_order.remove(key);
+			_order.push_back(key);
+			_entries[key] = positions;
+		}
+	}
+
+	evict();
+}
+
+
+void
+LayoutCache::save() const
+{
+	const string tmp_filename = _filename + ".tmp";
+
+	std::ofstream os(tmp_filename.c_str());
+	if (!os.good()) {
+		cerr << "Unable to write layout cache " << tmp_filename << endl;
+		return;
+	}
+
+	os.imbue(std::locale::classic());
+	os.precision(12);
+	os << LAYOUT_CACHE_MAGIC << '\n';
+	for (std::list<uint64_t>::const_iterator k = _order.begin(); k != _order.end(); ++k) {
+		const Positions& positions = _entries.find(*k)->second;
+		os << std::hex << *k << std::dec << ' ' << positions.size();
+		for (Positions::const_iterator p = positions.begin(); p != positions.end(); ++p)
+			os << ' ' << p->first << ' ' << p->second;
+		os << '\n';
+	}
+
+	os.close();
+	if (os.fail() || std::rename(tmp_filename.c_str(), _filename.c_str())) {
+		cerr << "Unable to write layout cache " << _filename << endl;
+		std::remove(tmp_filename.c_str());
+	}
+}
+
+
+} // namespace FlowCanvas
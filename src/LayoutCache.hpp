@@ -0,0 +1,98 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef FLOWCANVAS_LAYOUTCACHE_HPP
+#define FLOWCANVAS_LAYOUTCACHE_HPP
+
+#include <stdint.h>
+
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace FlowCanvas {
+
+
+/** Incremental 64-bit FNV-1a hash, used to key cached layouts.
+ */
+class LayoutHash {
+public:
+	LayoutHash() : _hash(14695981039346656037ULL) {}
+
+	void add(const void* data, size_t len) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < len; ++i) {
+			_hash ^= bytes[i];
+			_hash *= 1099511628211ULL;
+		}
+	}
+
+	void add(uint32_t v)           { add(&v, sizeof(v)); }
+	void add(const std::string& s) { add(uint32_t(s.length())); add(s.data(), s.length()); }
+
+	/** Add a coordinate or size, quantized so rounding noise doesn't miss. */
+	void add(double v) { add(uint32_t(int32_t(v * 100.0 + (v < 0 ? -0.5 : 0.5)))); }
+
+	uint64_t value() const { return _hash; }
+
+private:
+	uint64_t _hash;
+};
+
+
+/** Cache of auto-arrange results, keyed by a hash of the graph.
+ *
+ * Positions are stored in the canonical node order used to compute the key,
+ * so a hit can be applied directly without running GraphViz.  Entries are
+ * kept in memory, and optionally mirrored to a small file so layouts survive
+ * between sessions.
+ */
+class LayoutCache {
+public:
+	typedef std::vector< std::pair<double, double> > Positions;
+
+	explicit LayoutCache(size_t max_entries=32);
+
+	void               set_filename(const std::string& filename);
+	const std::string& filename() const { return _filename; }
+
+	bool find(uint64_t key, size_t n_nodes, Positions& positions);
+	void insert(uint64_t key, const Positions& positions);
+	void clear();
+
+	size_t memory_bytes() const;
+
+private:
+	void load();
+	void save() const;
+	void evict();
+
+	typedef std::map<uint64_t, Positions> Entries;
+
+	Entries             _entries;
+	std::list<uint64_t> _order; ///< Keys, least recently used first
+	std::string         _filename;
+	size_t              _max_entries;
+	bool                _loaded;
+};
+
+
+} // namespace FlowCanvas
+
+#endif // FLOWCANVAS_LAYOUTCACHE_HPP
@@ -0,0 +1,87 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef FLOWCANVAS_MEMORYACCOUNTING_HPP
+#define FLOWCANVAS_MEMORYACCOUNTING_HPP
+
+#include <stddef.h>
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Gnome { namespace Canvas { class Group; class Item; class Text; } }
+
+namespace FlowCanvas {
+
+struct MemoryUsage;
+
+/* Estimates of heap memory used by objects, for Canvas::memory_report().
+ * Container node sizes assume a typical implementation (two links per list
+ * node, three links and a colour per map node).
+ */
+
+/** Heap bytes of the count behind a shared_ptr made from a new object. */
+static const size_t SHARED_COUNT_BYTES = sizeof(void*) * 2 + sizeof(long) * 2;
+
+inline size_t
+string_heap_bytes(const std::string& s)
+{
+	// Short strings may be stored inside the object itself
+	const char* const obj = reinterpret_cast<const char*>(&s);
+	if (s.data() >= obj && s.data() < obj + sizeof(s))
+		return 0;
+	return s.capacity() + 1;
+}
+
+template<typename T>
+inline size_t
+vector_heap_bytes(const std::vector<T>& v)
+{
+	return v.capacity() * sizeof(T);
+}
+
+template<typename T>
+inline size_t
+list_heap_bytes(const std::list<T>& l)
+{
+	return l.size() * (sizeof(T) + sizeof(void*) * 2);
+}
+
+template<typename K, typename V>
+inline size_t
+map_heap_bytes(const std::map<K, V>& m)
+{
+	return m.size() * (sizeof(typename std::map<K, V>::value_type) + sizeof(void*) * 4);
+}
+
+/** Instance size of a GObject (0 if @a instance is NULL). */
+size_t gobject_bytes(const void* instance);
+
+size_t item_gobject_bytes(const Gnome::Canvas::Item* item);
+
+/** Instance size of a canvas group and its child list. */
+size_t group_gobject_bytes(const Gnome::Canvas::Group& group);
+
+/** Add a text item, including its Pango layout, to @a usage. */
+void account_text(MemoryUsage& usage, const Gnome::Canvas::Text* text);
+
+
+} // namespace FlowCanvas
+
+#endif // FLOWCANVAS_MEMORYACCOUNTING_HPP
@@ -0,0 +1,99 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <cstring>
+
+#include <libgnomecanvasmm.h>
+
+#include "flowcanvas/MemoryReport.hpp"
+#include "MemoryAccounting.hpp"
+
+namespace FlowCanvas {
+
+
+const char*
+memory_category_name(MemoryCategory category)
+{
+	switch (category) {
+	case MEM_MODULES:         return "modules";
+	case MEM_ITEMS:           return "items";
+	case MEM_PORTS:           return "ports";
+	case MEM_CONNECTIONS:     return "connections";
+	case MEM_MODEL:           return "model";
+	case MEM_CANVAS:          return "canvas";
+	case N_MEMORY_CATEGORIES: break;
+	}
+	return "unknown";
+}
+
+
+MemoryUsage
+MemoryReport::total() const
+{
+	MemoryUsage total;
+	for (unsigned i = 0; i < N_MEMORY_CATEGORIES; ++i)
+		total.add(usage[i]);
+	return total;
+}
+
+
+size_t
+gobject_bytes(const void* instance)
+{
+	if (!instance)
+		return 0;
+
+	GTypeQuery query;
+	g_type_query(G_TYPE_FROM_INSTANCE(instance), &query);
+	return query.instance_size;
+}
+
+
+size_t
+item_gobject_bytes(const Gnome::Canvas::Item* item)
+{
+	return item ? gobject_bytes(item->gobj()) : 0;
+}
+
+
+size_t
+group_gobject_bytes(const Gnome::Canvas::Group& group)
+{
+	return gobject_bytes(group.gobj())
+		+ g_list_length(group.gobj()->item_list) * sizeof(GList);
+}
+
+
+void
+account_text(MemoryUsage& usage, const Gnome::Canvas::Text* text)
+{
+	if (!text)
+		return;
+
+	const GnomeCanvasText* t = text->gobj();
+	usage.gobject_bytes += gobject_bytes(t);
+	if (t->text)
+		usage.text_bytes += strlen(t->text) + 1;
+	if (t->layout) {
+		usage.text_bytes += gobject_bytes(t->layout)
+			+ strlen(pango_layout_get_text(t->layout)) + 1
+			+ pango_layout_get_line_count(t->layout) * sizeof(PangoLayoutLine);
+	}
+}
+
+
+} // namespace FlowCanvas
@@ -26,6 +26,8 @@
 #include "flowcanvas/Canvas.hpp"
 #include "flowcanvas/Item.hpp"
 #include "flowcanvas/Module.hpp"
+#include "MemoryAccounting.hpp"
+#include "ScopedOperation.hpp"
 
 using std::list;
 using std::string;
@@ -59,6 +61,7 @@ Module::Module(
 	, _module_box(*this, 0, 0, 0, 0) // w, h set later
 	, _canvas_title(*this, 0, 8, name) // x set later
 	, _stacked_border(NULL)
+	, _select_outline(NULL)
 	, _icon_box(NULL)
 	, _embed_container(NULL)
 	, _embed_item(NULL)
@@ -103,10 +106,29 @@ Module::Module(
 Module::~Module()
 {
 	delete _stacked_border;
+	delete _select_outline;
 	delete _icon_box;
 }
 
 
+void
+Module::account_memory(MemoryReport& report) const
+{
+	MemoryUsage& usage = report[MEM_MODULES];
+	account_item_memory(usage, sizeof(Module));
+	usage.object_bytes  += vector_heap_bytes(_ports);
+	usage.gobject_bytes += item_gobject_bytes(&_module_box)
+		+ item_gobject_bytes(_stacked_border)
+		+ item_gobject_bytes(_select_outline)
+		+ item_gobject_bytes(_icon_box)
+		+ item_gobject_bytes(_embed_item);
+	account_text(usage, &_canvas_title);
+
+	for (PortVector::const_iterator p = _ports.begin(); p != _ports.end(); ++p)
+		(*p)->account_memory(report);
+}
+
+
 bool
 Module::on_event(GdkEvent* event)
 {
@@ -125,13 +147,7 @@ Module::on_event(GdkEvent* event)
 	default: break;
 	}
 
-	bool ret = Item::on_event(event);
-
-	if (event->type == GDK_ENTER_NOTIFY)
-		for (PortVector::iterator p = _ports.begin(); p != _ports.end(); ++p)
-			(*p)->raise_connections();
-
-	return ret;
+	return Item::on_event(event);
 }
 
 
@@ -160,6 +176,8 @@ Module::set_border_width(double w)
 	_module_box.property_width_units() = w;
 	if (_stacked_border)
 		_stacked_border->property_width_units() = w;
+	if (_select_outline)
+		_select_outline->property_width_units() = w;
 }
 
 
@@ -233,13 +251,23 @@ Module::set_selected(bool selected)
 	if (!canvas)
 		return;
 
-	if (selected) {
-		_module_box.property_outline_color_rgba() = MODULE_HILITE_OUTLINE_COLOUR;
-		_module_box.property_dash() = canvas->select_dash();
-	} else {
+	/* The animated dash is drawn by an unfilled rect on top of the box, so
+	 * select_tick() only redraws the outline and not the whole module. */
+	if (selected && !_select_outline) {
+		_module_box.property_outline_color_rgba() = 0x00000000;
+		_select_outline = new Gnome::Canvas::Rect(*this,
+			_module_box.property_x1(), _module_box.property_y1(),
+			_module_box.property_x2(), _module_box.property_y2());
+		_select_outline->property_outline_color_rgba() = MODULE_HILITE_OUTLINE_COLOUR;
+		_select_outline->property_width_units() = _border_width;
+		_select_outline->property_dash() = canvas->select_dash();
+		_select_outline->lower_to_bottom();
+		_select_outline->raise(_stacked_border ? 2 : 1); // Just above _module_box
+	} else if (!selected) {
+		delete _select_outline;
+		_select_outline = NULL;
 		_module_box.property_fill_color_rgba() = _color;
 		_module_box.property_outline_color_rgba() = MODULE_OUTLINE_COLOUR;
-		_module_box.property_dash() = NULL;
 	}
 }
 
@@ -267,35 +295,46 @@ Module::port_at(double x, double y)
 void
 Module::remove_port(boost::shared_ptr<Port> port)
 {
-	PortVector::iterator i = std::find(_ports.begin(), _ports.end(), port);
+	remove_ports(PortVector(1, port));
+}
 
-	if (i != _ports.end()) {
-		_ports.erase(i);
 
-		// Find new widest input or output, if necessary
-		if (port->is_input() && port->width() >= _widest_input) {
-			_widest_input = 0;
-			for (PortVector::iterator i = _ports.begin(); i != _ports.end(); ++i) {
-				const boost::shared_ptr<Port> p = (*i);
-				if (p->is_input() && p->width() >= _widest_input)
-					_widest_input = p->width();
-			}
-		} else if (port->is_output() && port->width() >= _widest_output) {
-			_widest_output = 0;
-			for (PortVector::iterator i = _ports.begin(); i != _ports.end(); ++i) {
-				const boost::shared_ptr<Port> p = (*i);
-				if (p->is_output() && p->width() >= _widest_output)
-					_widest_output = p->width();
-			}
+/** Remove @a ports from this module, resizing it once. */
+void
+Module::remove_ports(const PortVector& ports)
+{
+	boost::shared_ptr<Canvas> canvas = _canvas.lock();
+
+	bool removed = false;
+	for (PortVector::const_iterator p = ports.begin(); p != ports.end(); ++p) {
+		PortVector::iterator i = std::find(_ports.begin(), _ports.end(), *p);
+		if (i == _ports.end()) {
+			std::cerr << "Unable to find port " << (*p)->name() << " to remove." << std::endl;
+			continue;
 		}
 
-		resize();
-		port->hide();
-		port.reset();
+		_ports.erase(i);
+		if (canvas)
+			canvas->remove_port_from_model(**p);
+		(*p)->hide();
+		removed = true;
+	}
 
-	} else {
-		std::cerr << "Unable to find port " << port->name() << " to remove." << std::endl;
+	if (!removed)
+		return;
+
+	// Find new widest input and output
+	_widest_input  = 0;
+	_widest_output = 0;
+	for (PortVector::const_iterator i = _ports.begin(); i != _ports.end(); ++i) {
+		const Port& p = **i;
+		if (p.is_input())
+			_widest_input = std::max(_widest_input, p.width());
+		else
+			_widest_output = std::max(_widest_output, p.width());
 	}
+
+	resize();
 }
 
 
@@ -308,7 +347,10 @@ Module::set_width(double w)
 	_module_box.property_x2() = _module_box.property_x1() + w;
 	if (_stacked_border)
 		_stacked_border->property_x2() = _stacked_border->property_x1() + w;
+	if (_select_outline)
+		_select_outline->property_x2() = _select_outline->property_x1() + w;
 
+	update_bounds();
 	if (growing)
 		fit_canvas();
 }
@@ -323,7 +365,10 @@ Module::set_height(double h)
 	_module_box.property_y2() = _module_box.property_y1() + h;
 	if (_stacked_border)
 		_stacked_border->property_y2() = _stacked_border->property_y1() + h;
+	if (_select_outline)
+		_select_outline->property_y2() = _select_outline->property_y1() + h;
 
+	update_bounds();
 	if (growing)
 		fit_canvas();
 }
@@ -355,6 +400,7 @@ Module::move(double dx, double dy)
 		dy = canvas->height() - property_y() - _height;
 
 	Gnome::Canvas::Group::move(dx, dy);
+	update_bounds();
 
 	// Deal with moving the connection lines
 	for (PortVector::iterator p = _ports.begin(); p != _ports.end(); ++p)
@@ -385,11 +431,8 @@ Module::move_to(double x, double y)
 	assert(x >= 0);
 	assert(y >= 0);
 
-	if (x + _width >= canvas->width() || y + _height >= canvas->height()) {
-		double x1, y1, x2, y2;
-		canvas->get_scroll_region(x1, y1, x2, y2);
-		canvas->set_scroll_region(x1, y1, std::max(x2, x + _width), std::max(y2, y + _height));
-	}
+	if (x + _width >= canvas->width() || y + _height >= canvas->height())
+		canvas->expand(x + _width + 1.0, y + _height + 1.0);
 
 	property_x() = x;
 	property_y() = y;
@@ -406,10 +449,10 @@ Module::move_to(double x, double y)
 void
 Module::set_name(const string& n)
 {
-	if (_name != n) {
-		string old_name = _name;
+	if (_name.str() != n) {
 		_name = n;
-		_canvas_title.property_text() = _name;
+		name_changed();
+		_canvas_title.property_text() = n;
 		_title_width = _canvas_title.property_text_width();
 		_title_height = _canvas_title.property_text_height();
 		if (_title_visible)
@@ -440,11 +483,11 @@ Module::add_port(boost::shared_ptr<Port> p)
 	_ports.push_back(p);
 
 	boost::shared_ptr<Canvas> canvas = _canvas.lock();
-	if (canvas)
+	if (canvas) {
 		p->signal_event().connect(
 			sigc::bind(sigc::mem_fun(canvas.get(), &Canvas::port_event), p));
-
-	p->signal_renamed.connect(sigc::mem_fun(this, &Module::port_renamed));
+		canvas->add_port_to_model(p);
+	}
 }
 
 
@@ -508,6 +551,8 @@ Module::embed_size_request(Gtk::Requisition* r, bool force)
 void
 Module::measure_ports()
 {
+	FLOWCANVAS_INSTRUMENT_SCOPE(_canvas, OP_MEASURE_TEXT);
+
 	_widest_input = 0.0;
 	_widest_output = 0.0;
 	for (PortVector::iterator pi = _ports.begin(); pi != _ports.end(); ++pi) {
@@ -545,12 +590,52 @@ Module::resize()
 		resize_vert();
 		break;
 	}
+
+	update_port_models();
+}
+
+
+/** Update the canvas model with the current names and geometry of all ports.
+ */
+void
+Module::update_port_models()
+{
+	boost::shared_ptr<Canvas> canvas = _canvas.lock();
+	if (!canvas || _model_id == GraphModel::NONE)
+		return;
+
+	for (PortVector::const_iterator p = _ports.begin(); p != _ports.end(); ++p) {
+		const Port& port = **p;
+		if (port._model_id != GraphModel::NONE) {
+			canvas->_model.set_port_name(port._model_id, port.symbol());
+			canvas->_model.set_port_geometry(port._model_id,
+				port.property_x(), port.property_y(), port.width(), port.height());
+		}
+	}
+}
+
+
+/** Copy the name and geometry of @a port (which has changed) to the model. */
+void
+Module::update_port_model(const Port& port)
+{
+	if (port._model_id == GraphModel::NONE)
+		return;
+
+	boost::shared_ptr<Canvas> canvas = _canvas.lock();
+	if (canvas) {
+		canvas->_model.set_port_name(port._model_id, port.symbol());
+		canvas->_model.set_port_geometry(port._model_id,
+			port.property_x(), port.property_y(), port.width(), port.height());
+	}
 }
 
 
 void
 Module::resize_horiz()
 {
+	FLOWCANVAS_INSTRUMENT_SCOPE(_canvas, OP_RESIZE_MODULE);
+
 	if (_port_renamed) {
 		measure_ports();
 		_port_renamed = false;
@@ -694,6 +779,8 @@ Module::resize_horiz()
 void
 Module::resize_vert()
 {
+	FLOWCANVAS_INSTRUMENT_SCOPE(_canvas, OP_RESIZE_MODULE);
+
 	if (_port_renamed) {
 		measure_ports();
 		_port_renamed = false;
@@ -785,15 +872,8 @@ void
 Module::fit_canvas()
 {
 	boost::shared_ptr<Canvas> canvas = _canvas.lock();
-	if (canvas) {
-		double canvas_width  = canvas->width();
-		double canvas_height = canvas->height();
-
-		canvas_width  = std::max(canvas_width, property_x() + _width + 5.0);
-		canvas_height = std::max(canvas_height, property_y() + _height + 5.0);
-
-		canvas->resize(canvas_width, canvas_height);
-	}
+	if (canvas)
+		canvas->expand(property_x() + _width + 5.0, property_y() + _height + 5.0);
 }
 
 
@@ -801,8 +881,8 @@ void
 Module::select_tick()
 {
 	boost::shared_ptr<Canvas> canvas = _canvas.lock();
-	if (canvas)
-		_module_box.property_dash() = canvas->select_dash();
+	if (canvas && _select_outline)
+		_select_outline->property_dash() = canvas->select_dash();
 }
 
 
@@ -0,0 +1,77 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+#include <boost/pool/pool.hpp>
+
+#include "flowcanvas/PoolAllocator.hpp"
+
+namespace FlowCanvas {
+
+
+ObjectPools::ObjectPools()
+	: _live_bytes(0)
+{
+	for (size_t i = 0; i < MAX_SIZE / GRANULARITY; ++i)
+		_pools[i] = NULL;
+}
+
+
+ObjectPools::~ObjectPools()
+{
+	for (size_t i = 0; i < MAX_SIZE / GRANULARITY; ++i)
+		delete _pools[i];
+}
+
+
+void*
+ObjectPools::allocate(size_t size)
+{
+	if (size == 0 || size > MAX_SIZE)
+		return ::operator new(size);
+
+	const size_t i = (size - 1) / GRANULARITY;
+	if (!_pools[i])
+		_pools[i] = new Pool((i + 1) * GRANULARITY);
+
+	void* const ptr = _pools[i]->malloc();
+	if (!ptr)
+		throw std::bad_alloc();
+
+	_live_bytes += (i + 1) * GRANULARITY;
+	return ptr;
+}
+
+
+void
+ObjectPools::deallocate(void* ptr, size_t size)
+{
+	if (!ptr)
+		return;
+
+	if (size == 0 || size > MAX_SIZE) {
+		::operator delete(ptr);
+		return;
+	}
+
+	const size_t i = (size - 1) / GRANULARITY;
+	_pools[i]->free(ptr);
+	_live_bytes -= (i + 1) * GRANULARITY;
+}
+
+
+} // namespace FlowCanvas
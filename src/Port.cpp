@@ -18,7 +18,6 @@
 #include <algorithm>
 #include <cmath>
 #include <iostream>
-#include <list>
 #include <string>
 
 #include <boost/weak_ptr.hpp>
@@ -28,11 +27,11 @@
 #include "flowcanvas/Canvas.hpp"
 #include "flowcanvas/Module.hpp"
 #include "flowcanvas/Port.hpp"
+#include "MemoryAccounting.hpp"
 
 using std::cerr;
 using std::endl;
 using std::string;
-using std::list;
 
 static const uint32_t PORT_SELECTED_COLOR   = 0xFF0000FF;
 static const uint32_t PORT_EMPTY_PORT_BREADTH = 16;
@@ -54,6 +53,7 @@ Port::Port(boost::shared_ptr<Module> module, const string& name, bool is_input,
 	, _menu(NULL)
 	, _control(NULL)
 	, _color(color)
+	, _model_id(GraphModel::NONE)
 	, _is_input(is_input)
 	, _selected(false)
 	, _toggled(false)
@@ -63,7 +63,7 @@ Port::Port(boost::shared_ptr<Module> module, const string& name, bool is_input,
 
 	// Create label first and zoom (to find size correctly)
 	if (canvas->direction() == Canvas::HORIZONTAL)
-		_label = new Gnome::Canvas::Text(*this, 0, 0, _name);
+		_label = new Gnome::Canvas::Text(*this, 0, 0, _name.str());
 	else
 		_label = NULL;
 
@@ -101,6 +101,25 @@ Port::~Port()
 }
 
 
+void
+Port::account_memory(MemoryReport& report) const
+{
+	MemoryUsage& usage = report[MEM_PORTS];
+	++usage.count;
+	usage.object_bytes  += sizeof(Port) + SHARED_COUNT_BYTES + connections_heap_bytes();
+	usage.gobject_bytes += group_gobject_bytes(*this) + item_gobject_bytes(_rect);
+	account_text(usage, _label);
+
+	if (_control) {
+		usage.object_bytes  += sizeof(Control);
+		usage.gobject_bytes += item_gobject_bytes(_control->rect);
+	}
+
+	if (_menu)
+		usage.gobject_bytes += gobject_bytes(_menu->gobj());
+}
+
+
 void
 Port::show_control()
 {
@@ -123,14 +142,12 @@ Port::hide_control()
 }
 
 
-/** Set the value for this port's control slider to display.
+/** Clamp @a value to the control range (widening the range if necessary)
+ * and return the width of the gauge for it, or NaN if it has none.
  */
-void
-Port::set_control(float value, bool signal)
+double
+Port::control_gauge_width(float& value)
 {
-	if (!_control)
-		return;
-
 	if (_toggled) {
 		if (value != 0.0)
 			value = _control->max;
@@ -155,15 +172,33 @@ Port::set_control(float value, bool signal)
 	else if (inf == 1)
 		value = _control->max;
 
-	const double w = (value - _control->min) / (_control->max - _control->min) * _width;
+	return (value - _control->min) / (_control->max - _control->min) * _width;
+}
+
+
+void
+Port::draw_control(double w)
+{
+	_control->rect->property_x2() = _control->rect->property_x1() + std::max(0.0, w-1.0);
+	_control->width = w;
+}
+
+
+/** Set the value for this port's control slider to display.
+ */
+void
+Port::set_control(float value, bool signal)
+{
+	if (!_control)
+		return;
+
+	const double w = control_gauge_width(value);
 	if (std::isnan(w)) {
-		cerr << "WARNING (" << _name << "): Control value is NaN" << endl;
+		cerr << "WARNING (" << _name.str() << "): Control value is NaN" << endl;
 		return;
 	}
 
-	//cerr << w << " / " << _width << endl;
-
-	_control->rect->property_x2() = _control->rect->property_x1() + std::max(0.0, w-1.0);
+	draw_control(w);
 	if (signal && _control->value == value)
 		signal = false;
 
@@ -174,6 +209,33 @@ Port::set_control(float value, bool signal)
 }
 
 
+/** Set the control value from a stream of values (see Canvas::stream_control()).
+ *
+ * Unlike set_control(), the gauge is only redrawn if it is @a visible and
+ * would move by at least @a min_dx, and no signal is emitted.  Returns true
+ * iff the gauge is now within @a min_dx of the value.
+ */
+bool
+Port::stream_control(float value, bool visible, double min_dx)
+{
+	if (!_control)
+		return true;
+
+	const double w = control_gauge_width(value);
+	if (std::isnan(w))
+		return true;
+
+	_control->value = value;
+	if (std::fabs(w - _control->width) < min_dx)
+		return true;
+	else if (!visible)
+		return false;
+
+	draw_control(w);
+	return true;
+}
+
+
 void
 Port::set_control_min(float min)
 {
@@ -231,23 +293,27 @@ Port::natural_width() const
 void
 Port::set_name(const string& n)
 {
-	if (_label && _name != n) {
+	if (_label && _name.str() != n) {
 		_name = n;
 
 		// Reposition label
-		_label->property_text() = _name;
+		_label->property_text() = n;
 		const double text_width = _label->property_text_width();
 		_width = text_width + 6.0;
 		_height = _label->property_text_height();
 		_rect->property_x2() = _width;
 		_rect->property_y2() = _height;
 		if (_control) {
-			_control->rect->property_x2() = _control->rect->property_x1() + (_control->value * (_width-1));
+			set_control(_control->value, false); // Resize gauge to new width
 			_control->rect->property_y2() = _height - 0.5;
 		}
 		_label->property_x() = (_width / 2.0) - 3.0;
 		_label->property_y() = (_height / 2.0);
 
+		boost::shared_ptr<Module> module = _module.lock();
+		if (module)
+			module->port_renamed(*this);
+
 		signal_renamed.emit();
 	}
 }
@@ -295,15 +361,23 @@ Port::disconnect_all()
 	if (!module)
 		return;
 
-	list<boost::weak_ptr<Connection> > connections = _connections; // copy
-	for (list<boost::weak_ptr<Connection> >::iterator i = connections.begin(); i != connections.end(); ++i) {
-		boost::shared_ptr<Connection> c = (*i).lock();
-		if (c) {
-			module->canvas().lock()->disconnect(c->source().lock(), c->dest().lock());
-		}
+	boost::shared_ptr<Canvas> canvas = module->canvas().lock();
+	if (!canvas)
+		return;
+
+	Canvas::ConnectablePairs pairs;
+	pairs.reserve(_connections.size());
+	for (Connections::iterator i = _connections.begin(); i != _connections.end(); ++i) {
+		const Connection* const c = i->get();
+		pairs.push_back(Canvas::ConnectablePair(c->source().lock(), c->dest().lock()));
 	}
 
-	_connections.clear();
+	if (pairs.size() == 1)
+		canvas->disconnect(pairs[0].first, pairs[0].second);
+	else if (!pairs.empty())
+		canvas->disconnect_many(pairs);
+
+	clear_connections();
 }
 
 
@@ -319,7 +393,7 @@ Port::show_label(bool b)
 	if (b) {
 		// Create label first then zoom (to find size correctly)
 		if (!_label)
-			_label = new Gnome::Canvas::Text(*this, 0, 0, _name);
+			_label = new Gnome::Canvas::Text(*this, 0, 0, _name.str());
 
 		zoom(canvas->get_zoom());
 
@@ -373,12 +447,10 @@ Port::set_highlighted(bool b, bool highlight_parent, bool highlight_connections,
 
 	if (highlight_connections) {
 		for (Connections::iterator i = _connections.begin(); i != _connections.end(); ++i) {
-			boost::shared_ptr<Connection> connection = (*i).lock();
-			if (connection) {
-				connection->set_highlighted(b);
-				if (raise_connections && b)
-					connection->raise_to_top();
-			}
+			Connection* const connection = i->get();
+			connection->set_highlighted(b);
+			if (raise_connections || !b)
+				connection->set_raised(b);
 		}
 	}
 
@@ -441,6 +513,10 @@ Port::set_width(double w)
 	_width = w;
 	if (_control)
 		set_control(_control->value, false);
+
+	boost::shared_ptr<Module> module = _module.lock();
+	if (module)
+		module->update_port_model(*this);
 }
 
 
@@ -452,6 +528,10 @@ Port::set_height(double h)
 	if (_control)
 		_control->rect->property_y2() = _control->rect->property_y1() + h - 0.5;
 	_height = h;
+
+	boost::shared_ptr<Module> module = _module.lock();
+	if (module)
+		module->update_port_model(*this);
 }
 
 
@@ -0,0 +1,78 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef FLOWCANVAS_SCOPEDOPERATION_HPP
+#define FLOWCANVAS_SCOPEDOPERATION_HPP
+
+#include "flowcanvas-config.h"
+
+#ifdef FLOWCANVAS_INSTRUMENT
+
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include "flowcanvas/Canvas.hpp"
+#include "flowcanvas/Instrument.hpp"
+#include "Clock.hpp"
+
+namespace FlowCanvas {
+
+
+/** Times the enclosing scope and adds it to the canvas statistics and trace.
+ *
+ * Use via FLOWCANVAS_INSTRUMENT_SCOPE, which compiles to nothing unless
+ * configured with --instrument.
+ */
+class ScopedOperation {
+public:
+	ScopedOperation(Canvas* canvas, Operation op)
+		: _canvas(canvas), _op(op), _start(now_us())
+	{}
+
+	ScopedOperation(const boost::weak_ptr<Canvas>& canvas, Operation op)
+		: _ref(canvas.lock()), _canvas(_ref.get()), _op(op), _start(now_us())
+	{}
+
+	~ScopedOperation() {
+		if (_canvas)
+			_canvas->record_operation(_op, _start, now_us() - _start);
+	}
+
+	static inline uint64_t now_us() { return monotonic_us(); }
+
+private:
+	boost::shared_ptr<Canvas> _ref;
+	Canvas*                   _canvas;
+	const Operation           _op;
+	const uint64_t            _start;
+};
+
+
+} // namespace FlowCanvas
+
+#define FLOWCANVAS_INSTRUMENT_SCOPE(canvas, op) \
+	FlowCanvas::ScopedOperation scoped_operation_(canvas, op)
+
+#else
+
+#define FLOWCANVAS_INSTRUMENT_SCOPE(canvas, op)
+
+#endif // FLOWCANVAS_INSTRUMENT
+
+#endif // FLOWCANVAS_SCOPEDOPERATION_HPP
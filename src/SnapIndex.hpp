@@ -0,0 +1,111 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+#ifndef FLOWCANVAS_SNAPINDEX_HPP
+#define FLOWCANVAS_SNAPINDEX_HPP
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+
+namespace FlowCanvas {
+
+class Port;
+
+
+/** Ports a dragged connection may snap to, bucketed in a uniform grid.
+ *
+ * Built once when a connection drag starts, so each pointer motion only
+ * looks at the few ports in the cells around the pointer instead of
+ * scanning every item on the canvas.
+ */
+class SnapIndex {
+public:
+	enum { CELL_SIZE = 64 }; ///< Grid cell width and height (world units)
+
+	void clear() { _targets.clear(); _cells.clear(); }
+	bool empty() const { return _targets.empty(); }
+
+	/** Add @a port with world bounds (@a x1, @a y1) - (@a x2, @a y2). */
+	void add(const boost::shared_ptr<Port>& port, double x1, double y1, double x2, double y2) {
+		const uint32_t index = _targets.size();
+		_targets.push_back(Target(port, x1, y1, x2, y2));
+		for (int cx = cell(x1); cx <= cell(x2); ++cx)
+			for (int cy = cell(y1); cy <= cell(y2); ++cy)
+				_cells[Cell(cx, cy)].push_back(index);
+	}
+
+	/** Return the port nearest to (@a x, @a y), if it is within @a max_distance.
+	 *
+	 * A port containing the point is at distance 0, so it always wins.
+	 */
+	boost::shared_ptr<Port> nearest(double x, double y, double max_distance) const {
+		const Target* best          = NULL;
+		double        best_distance = max_distance * max_distance;
+		for (int cx = cell(x - max_distance); cx <= cell(x + max_distance); ++cx) {
+			for (int cy = cell(y - max_distance); cy <= cell(y + max_distance); ++cy) {
+				const Cells::const_iterator c = _cells.find(Cell(cx, cy));
+				if (c == _cells.end())
+					continue;
+
+				for (std::vector<uint32_t>::const_iterator i = c->second.begin();
+				     i != c->second.end(); ++i) {
+					const Target& t  = _targets[*i];
+					const double  dx = std::max(std::max(t.x1 - x, x - t.x2), 0.0);
+					const double  dy = std::max(std::max(t.y1 - y, y - t.y2), 0.0);
+					const double  d  = dx * dx + dy * dy;
+					if (d < best_distance || (!best && d == best_distance)) {
+						best          = &t;
+						best_distance = d;
+					}
+				}
+			}
+		}
+
+		return best ? best->port.lock() : boost::shared_ptr<Port>();
+	}
+
+private:
+	struct Target {
+		Target(const boost::shared_ptr<Port>& p, double x1_, double y1_, double x2_, double y2_)
+			: port(p), x1(x1_), y1(y1_), x2(x2_), y2(y2_) {}
+
+		boost::weak_ptr<Port> port;
+		double                x1, y1, x2, y2;
+	};
+
+	typedef std::pair<int, int>                     Cell;
+	typedef std::map<Cell, std::vector<uint32_t> >  Cells;
+
+	static int cell(double coord) { return static_cast<int>(floor(coord / double(CELL_SIZE))); }
+
+	std::vector<Target> _targets;
+	Cells               _cells;
+};
+
+
+} // namespace FlowCanvas
+
+#endif // FLOWCANVAS_SNAPINDEX_HPP
@@ -0,0 +1,102 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <map>
+
+#include "flowcanvas/Symbol.hpp"
+#include "MemoryAccounting.hpp"
+
+namespace FlowCanvas {
+
+
+typedef std::map<std::string, unsigned> SymbolTable;
+
+static SymbolTable&
+symbol_table()
+{
+	static SymbolTable table;
+	return table;
+}
+
+
+/** The empty symbol, which is not in the table and never released. */
+static std::pair<const std::string, unsigned>*
+empty_entry()
+{
+	static std::pair<const std::string, unsigned> empty(std::string(), 1);
+	return &empty;
+}
+
+
+static std::pair<const std::string, unsigned>*
+intern(const std::string& str)
+{
+	return &*symbol_table().insert(std::make_pair(str, 0u)).first;
+}
+
+
+Symbol::Symbol()
+	: _entry(empty_entry())
+{
+	++_entry->second;
+}
+
+
+Symbol::Symbol(const std::string& str)
+	: _entry(str.empty() ? empty_entry() : intern(str))
+{
+	++_entry->second;
+}
+
+
+Symbol::Symbol(const char* str)
+	: _entry((str && *str) ? intern(std::string(str)) : empty_entry())
+{
+	++_entry->second;
+}
+
+
+Symbol
+Symbol::find(const std::string& str)
+{
+	SymbolTable&          table = symbol_table();
+	SymbolTable::iterator i     = table.find(str);
+	return (i != table.end()) ? Symbol(&*i) : Symbol();
+}
+
+
+/** Free the string of @a entry, which has no symbols left. */
+void
+Symbol::release(Entry* entry)
+{
+	SymbolTable& table = symbol_table();
+	table.erase(table.find(entry->first));
+}
+
+
+size_t
+Symbol::table_bytes()
+{
+	const SymbolTable& table = symbol_table();
+	size_t             bytes = 0;
+	for (SymbolTable::const_iterator i = table.begin(); i != table.end(); ++i)
+		bytes += sizeof(*i) + sizeof(void*) * 4 + string_heap_bytes(i->first);
+	return bytes;
+}
+
+
+} // namespace FlowCanvas
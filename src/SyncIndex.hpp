@@ -0,0 +1,62 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+#ifndef FLOWCANVAS_SYNCINDEX_HPP
+#define FLOWCANVAS_SYNCINDEX_HPP
+
+#include <map>
+#include <string>
+
+#include <boost/weak_ptr.hpp>
+
+#include "MemoryAccounting.hpp"
+
+namespace FlowCanvas {
+
+class Module;
+class Port;
+
+
+/** The objects Canvas::sync() created, by their IDs in the description. */
+struct SyncIndex {
+	typedef std::map<std::string, boost::weak_ptr<Port> > Ports;
+
+	struct SyncedModule {
+		boost::weak_ptr<Module> module;
+		Ports                   ports;
+	};
+
+	typedef std::map<std::string, SyncedModule> Modules;
+
+	size_t memory_bytes() const {
+		size_t bytes = sizeof(SyncIndex) + map_heap_bytes(modules);
+		for (Modules::const_iterator m = modules.begin(); m != modules.end(); ++m) {
+			bytes += string_heap_bytes(m->first) + map_heap_bytes(m->second.ports);
+			for (Ports::const_iterator p = m->second.ports.begin(); p != m->second.ports.end(); ++p)
+				bytes += string_heap_bytes(p->first);
+		}
+		return bytes;
+	}
+
+	Modules modules;
+};
+
+
+} // namespace FlowCanvas
+
+#endif // FLOWCANVAS_SYNCINDEX_HPP
@@ -0,0 +1,97 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <fstream>
+#include <iostream>
+#include <locale>
+
+#include "TraceBuffer.hpp"
+
+using std::cerr;
+using std::endl;
+
+namespace FlowCanvas {
+
+
+TraceBuffer::TraceBuffer(unsigned order)
+	: _events(new Event[1 << order])
+	, _mask((1 << order) - 1)
+	, _head(0)
+{
+	for (guint i = 0; i <= _mask; ++i)
+		_events[i].seq = 0;
+}
+
+
+TraceBuffer::~TraceBuffer()
+{
+	delete[] _events;
+}
+
+
+/** Return a small number identifying the calling thread. */
+uint16_t
+TraceBuffer::thread_id()
+{
+	const uintptr_t self = reinterpret_cast<uintptr_t>(g_thread_self());
+	return uint16_t((self >> 4) ^ (self >> 20)) | 1;
+}
+
+
+/** Write all recorded spans, oldest first, in Chrome trace event format.
+ *
+ * The file can be loaded in chrome://tracing or any compatible viewer.
+ */
+bool
+TraceBuffer::write_chrome_json(const std::string& filename) const
+{
+	std::ofstream os(filename.c_str());
+	if (!os.good()) {
+		cerr << "Unable to open " << filename << endl;
+		return false;
+	}
+
+	os.imbue(std::locale::classic());
+	os << "{\"traceEvents\":[";
+
+	const guint head  = guint(g_atomic_int_get(&_head));
+	const guint count = (head > _mask) ? _mask + 1 : head;
+	bool        first = true;
+	for (guint i = head - count; i != head; ++i) {
+		const Event& slot = _events[i & _mask];
+		if (guint(g_atomic_int_get(&slot.seq)) != i + 1)
+			continue;
+
+		const Event ev = slot;
+		if (guint(g_atomic_int_get(&slot.seq)) != i + 1)
+			continue; // Overwritten while copying
+
+		os << (first ? "\n" : ",\n")
+		   << "{\"name\":\"" << operation_name(Operation(ev.op)) << "\""
+		   << ",\"cat\":\"flowcanvas\",\"ph\":\"X\""
+		   << ",\"ts\":" << ev.start_us
+		   << ",\"dur\":" << ev.dur_us
+		   << ",\"pid\":1,\"tid\":" << ev.thread << "}";
+		first = false;
+	}
+
+	os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	return os.good();
+}
+
+
+} // namespace FlowCanvas
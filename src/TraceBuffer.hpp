@@ -0,0 +1,85 @@
+/* This file is part of FlowCanvas.
+ * Copyright (C) 2007-2009 David Robillard <http://drobilla.net>
+ *
+ * FlowCanvas is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * FlowCanvas is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef FLOWCANVAS_TRACEBUFFER_HPP
+#define FLOWCANVAS_TRACEBUFFER_HPP
+
+#include <stdint.h>
+
+#include <string>
+
+#include <glib.h>
+
+#include "flowcanvas/Instrument.hpp"
+
+namespace FlowCanvas {
+
+
+/** Fixed size ring buffer of timed operation spans.
+ *
+ * Recording is lock-free and safe from any thread: writers claim a slot
+ * with an atomic increment, and each slot carries a sequence number so a
+ * reader can skip slots that are being overwritten.  When full, the
+ * oldest spans are overwritten.
+ */
+class TraceBuffer {
+public:
+	/** Create a buffer of 2^@a order events. */
+	explicit TraceBuffer(unsigned order=16);
+	~TraceBuffer();
+
+	inline void record(Operation op, uint64_t start_us, uint64_t dur_us);
+
+	bool write_chrome_json(const std::string& filename) const;
+
+	size_t memory_bytes() const { return sizeof(TraceBuffer) + (_mask + 1) * sizeof(Event); }
+
+private:
+	struct Event {
+		volatile gint seq; ///< Index + 1 when complete, 0 while writing
+		uint32_t      dur_us;
+		uint64_t      start_us;
+		uint16_t      op;
+		uint16_t      thread;
+	};
+
+	static uint16_t thread_id();
+
+	Event*       _events;
+	const guint  _mask;
+	volatile gint _head;
+};
+
+
+inline void
+TraceBuffer::record(Operation op, uint64_t start_us, uint64_t dur_us)
+{
+	const guint i  = guint(g_atomic_int_add(&_head, 1));
+	Event&      ev = _events[i & _mask];
+
+	g_atomic_int_set(&ev.seq, 0);
+	ev.start_us = start_us;
+	ev.dur_us   = (dur_us > 0xFFFFFFFF) ? 0xFFFFFFFF : uint32_t(dur_us);
+	ev.op       = uint16_t(op);
+	ev.thread   = thread_id();
+	g_atomic_int_set(&ev.seq, gint(i + 1));
+}
+
+
+} // namespace FlowCanvas
+
+#endif // FLOWCANVAS_TRACEBUFFER_HPP